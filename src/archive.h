@@ -0,0 +1,179 @@
+#pragma once
+
+#include "sdl.h"
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Asset_archive: Every image of assets/ decoded once into a single file (see `make archive`).
+//
+// The file starts with a header and a directory of records, followed by the pixels of
+// every image in SDL::Pixel::format, tightly packed rows, each image 16 bytes aligned.
+// It is memory mapped, so surfaces point straight into the mapping and loading an
+// image costs neither a decode nor a copy until its texture is created. Images that
+// are not in the archive, or every image when there is no archive, are loaded from
+// their loose files. The archive is a build artifact in native byte order.
+class Asset_archive {
+    public:
+	static inline const std::string file = "assets.pak";
+
+    private:
+	static constexpr char magic[8] = { 'M', 'E', 'T', 'E', 'O', 'R', 'P', 'K' };
+	static constexpr Uint32 version = 1;
+	static constexpr std::size_t alignment = 16;
+
+	struct Header {
+		char magic[8];
+		Uint32 version;
+		Uint32 count;
+	};
+
+	struct Record {
+		char name[64];
+		Uint32 w, h;
+		Uint64 offset;
+	};
+
+	struct Entry {
+		std::size_t offset;
+		int w, h;
+	};
+
+	std::shared_ptr<std::byte> data{};
+	std::size_t size = 0;
+	std::unordered_map<std::string, Entry> entries{};
+
+	Asset_archive(const std::string &path)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+
+		struct stat st;
+		void *map = MAP_FAILED;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			size = static_cast<std::size_t>(st.st_size);
+			// private and writable so surfaces can point into it, nothing ever writes to it
+			map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		}
+		::close(fd);
+		if (map == MAP_FAILED) {
+			SDL::warn("Could not map " + path);
+			return;
+		}
+		std::size_t length = size;
+		data = std::shared_ptr<std::byte>(static_cast<std::byte *>(map), [length](std::byte *ptr) {
+			munmap(ptr, length);
+		});
+
+		if (!read_directory()) {
+			SDL::warn(path + " is not a valid asset archive, using the loose files");
+			entries.clear();
+			data.reset();
+		}
+	}
+
+	bool read_directory()
+	{
+		Header header;
+		if (size < sizeof(header))
+			return false;
+		std::memcpy(&header, data.get(), sizeof(header));
+		if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version)
+			return false;
+		if (size < sizeof(Header) + header.count * sizeof(Record))
+			return false;
+
+		for (Uint32 i = 0; i < header.count; i++) {
+			Record record;
+			std::memcpy(&record, data.get() + sizeof(Header) + i * sizeof(Record), sizeof(record));
+			std::size_t bytes = std::size_t(record.w) * record.h * sizeof(SDL::Pixel);
+			if (record.offset % alignment != 0 || record.offset > size || bytes > size - record.offset)
+				return false;
+			record.name[sizeof(record.name) - 1] = '\0';
+			entries[record.name] = { static_cast<std::size_t>(record.offset), static_cast<int>(record.w),
+						 static_cast<int>(record.h) };
+		}
+		return true;
+	}
+
+	static const Asset_archive &get()
+	{
+		static const Asset_archive archive(file);
+		return archive;
+	}
+
+    public:
+	// Surface of the image at path, pointing into the archive when it holds the image.
+	// Safe to call from several threads.
+	static SDL::Surface load(const std::string &path)
+	{
+		const Asset_archive &archive = get();
+		auto it = archive.entries.find(path);
+		if (it == archive.entries.end())
+			return SDL::Surface(path);
+
+		const Entry &e = it->second;
+		auto *pixels = reinterpret_cast<SDL::Pixel *>(archive.data.get() + e.offset);
+		return SDL::Surface(std::span<SDL::Pixel>(pixels, static_cast<std::size_t>(e.w * e.h)), e.w, e.h);
+	}
+
+	// Decodes every image and writes the archive.
+	static void write(const std::string &path, const std::vector<std::string> &images)
+	{
+		std::vector<SDL::Surface> surfaces;
+		std::vector<Record> records;
+		Uint64 offset = sizeof(Header) + images.size() * sizeof(Record);
+		for (const auto &image : images) {
+			if (image.size() >= sizeof(Record::name))
+				throw std::runtime_error("Asset name too long: " + image);
+			const SDL::Surface &surface = surfaces.emplace_back(image);
+
+			Record record{};
+			std::strncpy(record.name, image.c_str(), sizeof(record.name) - 1);
+			record.w = static_cast<Uint32>(surface.getWidth());
+			record.h = static_cast<Uint32>(surface.getHeight());
+			offset = (offset + alignment - 1) / alignment * alignment;
+			record.offset = offset;
+			offset += Uint64(record.w) * record.h * sizeof(SDL::Pixel);
+			records.push_back(record);
+		}
+
+		Header header{};
+		std::memcpy(header.magic, magic, sizeof(magic));
+		header.version = version;
+		header.count = static_cast<Uint32>(records.size());
+
+		std::ofstream out(path, std::ios::out | std::ios::binary);
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char *>(records.data()),
+			  static_cast<std::streamsize>(records.size() * sizeof(Record)));
+
+		for (std::size_t i = 0; i < surfaces.size(); i++) {
+			out.seekp(static_cast<std::streamoff>(records[i].offset));
+
+			// surface rows may be padded, the archive rows are not
+			auto pixels = surfaces[i].lock();
+			std::size_t w = records[i].w, h = records[i].h;
+			std::size_t stride = h == 0 ? 0 : pixels.size() / h;
+			for (std::size_t y = 0; y < h; y++)
+				out.write(reinterpret_cast<const char *>(pixels.data() + y * stride),
+					  static_cast<std::streamsize>(w * sizeof(SDL::Pixel)));
+			surfaces[i].unlock();
+		}
+		if (!out)
+			throw std::runtime_error("Could not write " + path);
+	}
+};
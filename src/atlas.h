@@ -0,0 +1,280 @@
+#pragma once
+
+#include "batch.h"
+#include "cache.h"
+#include "sdl.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Sheet: A horizontal strip of equally sized frames that is packed into the atlas.
+// Frames are named "<name>:<index>".
+struct Sheet {
+	const char *name;
+	const char *file;
+	int frame_w, frame_h;
+	int count;
+	bool trim = true;
+};
+
+inline constexpr std::array<Sheet, 11> sprite_sheets = { {
+	{ "asteroid", "assets/asteroid.png", 96, 96, 10 },
+	{ "asteroid_highlight", "assets/asteroid_highlight.png", 96, 96, 10 },
+	{ "hex", "assets/hex.png", 96, 96, 5 },
+	{ "ball", "assets/ball.png", 32, 32, 8 },
+	{ "powerups", "assets/powerups.png", 16, 16, 8 },
+	{ "shield", "assets/shield.png", 64, 64, 10 },
+	{ "ship_forward", "assets/ship_forward.png", 64, 64, 9 },
+	{ "ship_left", "assets/ship_left.png", 64, 64, 9 },
+	{ "ship_right", "assets/ship_right.png", 64, 64, 9 },
+	{ "side", "assets/side.png", 128, 512, 1 },
+	// the background is tiled so it keeps its full cell, only its first frame is ever on screen
+	{ "bg", "assets/bg.png", 360, 360, 1, false },
+} };
+
+// Atlas: All gameplay sprites packed and trimmed into a single texture.
+//
+// Every frame remembers where its trimmed pixels sit inside the original cell, so
+// drawing a frame at the top-left corner of its cell gives the same result as
+// copying the untrimmed cell from the original sheet.
+class Atlas {
+    public:
+	struct Frame {
+		SDL::Rect src;
+		int off_x, off_y;
+		int w, h; // size of the untrimmed cell
+	};
+
+	static constexpr int width = 1024;
+	static constexpr int padding = 1;
+	static inline const std::string image_file = "assets/atlas.png";
+	static inline const std::string table_file = "assets/atlas.txt";
+
+	// Packs every frame of the sprite sheets into a new surface and fills the frame table.
+	static SDL::Surface pack(std::unordered_map<std::string, Frame> &frames);
+
+	// Writes the table next to the image, one "name x y w h off_x off_y cell_w cell_h" line per frame.
+	static void save_table(const std::string &file, const std::unordered_map<std::string, Frame> &frames);
+
+	// Loads the prebuilt atlas (see `make atlas`) and falls back to packing the loose
+	// sheets in memory when it has not been generated.
+	Atlas(SDL::Renderer &renderer)
+		: frames()
+		, texture(load(renderer, frames))
+	{
+	}
+
+	// Loads the table and texture shared by every Atlas ahead of the first one, e.g. at startup.
+	static void preload(SDL::Renderer &renderer)
+	{
+		std::shared_ptr<const Table> frames;
+		load(renderer, frames);
+	}
+
+	const Frame &frame(const std::string &name) const
+	{
+		auto it = frames->find(name);
+		if (it == frames->end())
+			throw std::out_of_range("Atlas::frame: " + name);
+		return it->second;
+	}
+
+	// Returns the frames of a sheet, in order, for index based lookups in hot loops.
+	std::vector<Frame> sheet(const std::string &name) const
+	{
+		std::vector<Frame> res;
+		for (auto it = frames->find(name + ":0"); it != frames->end();
+		     it = frames->find(name + ":" + std::to_string(res.size())))
+			res.push_back(it->second);
+		if (res.empty())
+			throw std::out_of_range("Atlas::sheet: " + name);
+		return res;
+	}
+
+	const SDL::Texture &get_texture() const
+	{
+		return texture;
+	}
+
+	// Draws a frame whose untrimmed cell has its top-left corner at (x, y).
+	void draw(Sprite_batch &batch, const Frame &frame, float x, float y) const
+	{
+		if (frame.src.w == 0 || frame.src.h == 0)
+			return;
+		SDL::FRect dst = { x + static_cast<float>(frame.off_x), y + static_cast<float>(frame.off_y),
+				   static_cast<float>(frame.src.w), static_cast<float>(frame.src.h) };
+		batch.draw(texture, frame.src, dst);
+	}
+
+	// Draws a frame stretched so that its untrimmed cell covers dst.
+	void draw(Sprite_batch &batch, const Frame &frame, const SDL::FRect &dst) const
+	{
+		if (frame.src.w == 0 || frame.src.h == 0)
+			return;
+		float sx = dst.w / static_cast<float>(frame.w);
+		float sy = dst.h / static_cast<float>(frame.h);
+		SDL::FRect res = { dst.x + static_cast<float>(frame.off_x) * sx,
+				   dst.y + static_cast<float>(frame.off_y) * sy, static_cast<float>(frame.src.w) * sx,
+				   static_cast<float>(frame.src.h) * sy };
+		batch.draw(texture, frame.src, res);
+	}
+
+    private:
+	using Table = std::unordered_map<std::string, Frame>;
+
+	// the table and the texture (through Asset_cache) are shared by every Atlas
+	static inline std::shared_ptr<const Table> shared_table{};
+
+	std::shared_ptr<const Table> frames;
+	SDL::Texture texture;
+
+	static SDL::Texture load(SDL::Renderer &renderer, std::shared_ptr<const Table> &frames)
+	{
+		if (shared_table) {
+			if (auto texture = Asset_cache::find(image_file)) {
+				frames = shared_table;
+				return *texture;
+			}
+		}
+
+		auto table = std::make_shared<Table>();
+		std::optional<SDL::Texture> texture;
+		if (std::filesystem::exists(image_file) && std::filesystem::exists(table_file)) {
+			load_table(table_file, *table);
+			texture = Asset_cache::texture(renderer, image_file);
+		} else {
+			SDL::warn("Prebuilt atlas not found, packing sprites at startup");
+			texture = Asset_cache::insert(image_file, SDL::Texture(renderer, pack(*table)));
+		}
+
+		frames = shared_table = table;
+		return *texture;
+	}
+
+	static void load_table(const std::string &file, Table &frames)
+	{
+		std::ifstream table(file, std::ios::in);
+		std::string name;
+		Frame f{};
+		while (table >> name >> f.src.x >> f.src.y >> f.src.w >> f.src.h >> f.off_x >> f.off_y >> f.w >> f.h)
+			frames[name] = f;
+	}
+
+	// Smallest rectangle of the cell containing a non transparent pixel.
+	static SDL::Rect trim(std::span<const SDL::Pixel> pixels, std::size_t stride, const SDL::Rect &cell)
+	{
+		int x0 = cell.w, y0 = cell.h, x1 = -1, y1 = -1;
+		for (int y = 0; y < cell.h; y++) {
+			for (int x = 0; x < cell.w; x++) {
+				auto row = static_cast<std::size_t>(cell.y + y) * stride;
+				if (pixels[row + static_cast<std::size_t>(cell.x + x)].a == 0)
+					continue;
+				x0 = std::min(x0, x);
+				y0 = std::min(y0, y);
+				x1 = std::max(x1, x);
+				y1 = std::max(y1, y);
+			}
+		}
+		if (x1 < 0)
+			return { 0, 0, 0, 0 };
+		return { x0, y0, x1 - x0 + 1, y1 - y0 + 1 };
+	}
+};
+
+inline SDL::Surface Atlas::pack(std::unordered_map<std::string, Frame> &frames)
+{
+	struct Entry {
+		std::string name;
+		std::size_t sheet;
+		SDL::Rect src; // in the sheet
+		Frame frame;
+	};
+
+	// the sheets are decoded in parallel, then trimmed in order; always from the loose
+	// files, since the archive may still hold the pixels of a sheet edited since
+	std::vector<std::future<SDL::Surface> > decoding;
+	for (const Sheet &sheet : sprite_sheets)
+		decoding.push_back(std::async(std::launch::async, [&sheet] { return SDL::Surface(sheet.file); }));
+
+	std::vector<SDL::Surface> surfaces;
+	std::vector<Entry> entries;
+
+	for (std::size_t s = 0; s < sprite_sheets.size(); s++) {
+		const Sheet &sheet = sprite_sheets[s];
+		SDL::Surface &surface = surfaces.emplace_back(decoding[s].get());
+		surface.setBlendMode(SDL_BLENDMODE_NONE);
+
+		auto pixels = surface.lock();
+		std::size_t stride = pixels.size() / static_cast<std::size_t>(surface.getHeight());
+
+		for (int i = 0; i < sheet.count; i++) {
+			SDL::Rect cell = { i * sheet.frame_w, 0, sheet.frame_w, sheet.frame_h };
+			SDL::Rect box = sheet.trim ? trim(pixels, stride, cell) : SDL::Rect{ 0, 0, cell.w, cell.h };
+
+			Frame frame = { { 0, 0, box.w, box.h }, box.x, box.y, cell.w, cell.h };
+			entries.push_back({ std::string(sheet.name) + ":" + std::to_string(i), s,
+					    { cell.x + box.x, cell.y + box.y, box.w, box.h }, frame });
+		}
+		surface.unlock();
+	}
+
+	// shelf packing, tallest frames first
+	std::vector<std::size_t> order(entries.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+			 [&](std::size_t a, std::size_t b) { return entries[a].src.h > entries[b].src.h; });
+
+	int x = padding, y = padding, shelf = 0;
+	for (std::size_t i : order) {
+		Entry &e = entries[i];
+		if (e.src.w == 0 || e.src.h == 0)
+			continue;
+		if (x + e.src.w + padding > width) {
+			x = padding;
+			y += shelf + padding;
+			shelf = 0;
+		}
+		e.frame.src.x = x;
+		e.frame.src.y = y;
+		x += e.src.w + padding;
+		shelf = std::max(shelf, e.src.h);
+	}
+
+	SDL::Surface atlas(width, y + shelf + padding);
+	for (Entry &e : entries) {
+		if (e.src.w != 0 && e.src.h != 0) {
+			SDL::Rect dst = e.frame.src;
+			SDL::Surface::blit(surfaces[e.sheet], e.src, atlas, dst);
+		}
+		frames[e.name] = e.frame;
+	}
+
+	return atlas;
+}
+
+inline void Atlas::save_table(const std::string &file, const std::unordered_map<std::string, Frame> &frames)
+{
+	std::vector<std::string> names;
+	names.reserve(frames.size());
+	for (const auto &[name, frame] : frames)
+		names.push_back(name);
+	std::sort(names.begin(), names.end());
+
+	std::ofstream table(file, std::ios::out);
+	for (const auto &name : names) {
+		const Frame &f = frames.at(name);
+		table << name << ' ' << f.src.x << ' ' << f.src.y << ' ' << f.src.w << ' ' << f.src.h << ' ' << f.off_x
+		      << ' ' << f.off_y << ' ' << f.w << ' ' << f.h << '\n';
+	}
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "cache.h"
+#include "queue.h"
+#include "sdl.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <numbers>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Audio: Sound effects mixed on SDL's audio thread.
+//
+// Every sound is decoded once into mono float samples (from assets/<name>.wav, or
+// synthesized when the file does not exist) and never changes afterwards. The game
+// thread only pushes play commands to a lock-free queue; the audio callback drains
+// it at the start of each buffer, starts the sounds on a fixed pool of voices
+// (stealing the one closest to its end when all are busy) and mixes them. The
+// callback neither locks nor allocates, and its buffer is a few milliseconds long.
+// When no audio device can be opened, the game runs silent.
+class Audio {
+    public:
+	enum Sound { bounce, brick_hit, brick_break, sound_count };
+
+	static constexpr int frequency = 48000;
+	// 256 frames, about 5 ms at 48 kHz
+	static constexpr Uint16 buffer_frames = 256;
+	static constexpr std::size_t max_voices = 32;
+
+    private:
+	struct Command {
+		Sound sound;
+		float gain;
+	};
+
+	struct Voice {
+		const std::vector<float> *samples = nullptr;
+		std::size_t pos = 0;
+		float gain = 0;
+	};
+
+	static constexpr std::array<const char *, sound_count> names = { "bounce", "brick_hit", "brick_break" };
+
+	std::array<std::vector<float>, sound_count> samples{};
+	std::array<Voice, max_voices> voices{};
+	Spsc_queue<Command, 256> commands{};
+	// last so that the device, and its callback, stop before the rest goes away
+	std::optional<SDL::AudioDevice> device{};
+
+	static std::vector<float> synthesize(Sound sound)
+	{
+		constexpr float rate = frequency;
+		auto tone = [](float seconds, float freq, float decay) {
+			std::vector<float> res(static_cast<std::size_t>(seconds * rate));
+			for (std::size_t i = 0; i < res.size(); i++) {
+				float t = static_cast<float>(i) / rate;
+				res[i] = std::sin(2 * std::numbers::pi_v<float> * freq * t) * std::exp(-t * decay);
+			}
+			return res;
+		};
+
+		switch (sound) {
+		case bounce:
+			return tone(0.06f, 880, 60);
+		case brick_hit:
+			return tone(0.05f, 440, 70);
+		case brick_break: {
+			std::vector<float> res(static_cast<std::size_t>(0.2f * rate));
+			Uint32 seed = 0x9e3779b9;
+			for (std::size_t i = 0; i < res.size(); i++) {
+				seed ^= seed << 13;
+				seed ^= seed >> 17;
+				seed ^= seed << 5;
+				float noise = static_cast<float>(seed >> 8) / static_cast<float>(1 << 23) - 1;
+				res[i] = noise * std::exp(-static_cast<float>(i) / rate * 20);
+			}
+			return res;
+		}
+		case sound_count:
+			break;
+		}
+		return {};
+	}
+
+	void start(const Command &command)
+	{
+		const auto &sound = samples[static_cast<std::size_t>(command.sound)];
+		auto voice = std::find_if(voices.begin(), voices.end(), [](const Voice &v) { return !v.samples; });
+		if (voice == voices.end()) {
+			voice = std::min_element(voices.begin(), voices.end(), [](const Voice &a, const Voice &b) {
+				return a.samples->size() - a.pos < b.samples->size() - b.pos;
+			});
+		}
+		*voice = { &sound, 0, command.gain };
+	}
+
+	void mix(float *out, std::size_t frames)
+	{
+		while (auto command = commands.pop())
+			start(*command);
+
+		std::fill(out, out + frames, 0.f);
+		for (auto &voice : voices) {
+			if (!voice.samples)
+				continue;
+			std::size_t n = std::min(frames, voice.samples->size() - voice.pos);
+			const float *in = voice.samples->data() + voice.pos;
+			for (std::size_t i = 0; i < n; i++)
+				out[i] += in[i] * voice.gain;
+			voice.pos += n;
+			if (voice.pos == voice.samples->size())
+				voice.samples = nullptr;
+		}
+		for (std::size_t i = 0; i < frames; i++)
+			out[i] = std::clamp(out[i], -1.f, 1.f);
+	}
+
+	static void callback(void *userdata, Uint8 *stream, int len)
+	{
+		auto *audio = static_cast<Audio *>(userdata);
+		audio->mix(reinterpret_cast<float *>(stream), static_cast<std::size_t>(len) / sizeof(float));
+	}
+
+    public:
+	Audio()
+	{
+		for (std::size_t s = 0; s < sound_count; s++) {
+			auto sound = static_cast<Sound>(s);
+			std::string file = std::string("assets/") + names[s] + ".wav";
+			try {
+				samples[s] = std::filesystem::exists(file) ? SDL::loadWAV(file, frequency)
+					     : synthesize(sound);
+			} catch (std::exception const &) {
+				SDL::warn("Could not load " + file);
+				samples[s] = synthesize(sound);
+			}
+		}
+
+		try {
+			device.emplace(frequency, buffer_frames, &Audio::callback, this);
+			device->pause(false);
+		} catch (std::exception const &) {
+			SDL::warn("No audio device, sound is disabled");
+		}
+	}
+
+	Audio(const Audio &) = delete;
+	Audio &operator=(const Audio &) = delete;
+
+	// The instance shared by every state.
+	static std::shared_ptr<Audio> shared()
+	{
+		return Asset_cache::shared<Audio>("audio", [] { return std::make_shared<Audio>(); });
+	}
+
+	// Queues a sound, safe to call every frame from the game thread. Dropped when the
+	// queue is full, which only happens if the audio thread is stalled.
+	void play(Sound sound, float gain = 0.5f)
+	{
+		if (device)
+			commands.push({ sound, gain });
+	}
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "sdl.h"
+
+#include <cstddef>
+#include <vector>
+
+// Sprite_batch: Collects textured quads and submits them with SDL_RenderGeometry.
+//
+// Quads are accumulated as long as they use the same texture and flushed in a
+// single geometry call when the texture changes, so draw order is preserved.
+// The texture of pending quads must outlive the next flush(), and flush() must be
+// called before anything is drawn on the renderer directly.
+class Sprite_batch {
+    private:
+	SDL::Renderer &renderer;
+	const SDL::Texture *texture = nullptr;
+	float inv_w = 1, inv_h = 1;
+
+	std::vector<SDL::Vertex> vertices{};
+	std::vector<int> indices{};
+
+    public:
+	static constexpr SDL::Color white = { 255, 255, 255, 255 };
+
+	Sprite_batch(SDL::Renderer &renderer)
+		: renderer(renderer)
+	{
+	}
+
+	Sprite_batch(const Sprite_batch &) = delete;
+	Sprite_batch &operator=(const Sprite_batch &) = delete;
+
+	void draw(const SDL::Texture &tex, const SDL::Rect &src, const SDL::FRect &dst, const SDL::Color &color = white)
+	{
+		if (texture != &tex) {
+			flush();
+			texture = &tex;
+			inv_w = 1.f / static_cast<float>(tex.getWidth());
+			inv_h = 1.f / static_cast<float>(tex.getHeight());
+		}
+
+		float u0 = static_cast<float>(src.x) * inv_w;
+		float v0 = static_cast<float>(src.y) * inv_h;
+		float u1 = static_cast<float>(src.x + src.w) * inv_w;
+		float v1 = static_cast<float>(src.y + src.h) * inv_h;
+
+		int base = static_cast<int>(vertices.size());
+		vertices.push_back({ { dst.x, dst.y }, color, { u0, v0 } });
+		vertices.push_back({ { dst.x + dst.w, dst.y }, color, { u1, v0 } });
+		vertices.push_back({ { dst.x + dst.w, dst.y + dst.h }, color, { u1, v1 } });
+		vertices.push_back({ { dst.x, dst.y + dst.h }, color, { u0, v1 } });
+
+		indices.insert(indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+	}
+
+	void flush()
+	{
+		if (!vertices.empty())
+			renderer.geometry(*texture, vertices, indices);
+		vertices.clear();
+		indices.clear();
+		texture = nullptr;
+	}
+
+	std::size_t pending() const
+	{
+		return vertices.size() / 4;
+	}
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "archive.h"
+#include "sdl.h"
+
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Asset_cache: Process-wide cache of assets, keyed by path.
+//
+// Textures are shared handles, so every state asking for the same file gets the
+// same GPU texture and state transitions or restarts never hit the disk again.
+// Objects built from assets (glyph atlases, UI factories, ...) can be shared the
+// same way under a key of their own.
+// The game uses a single renderer; every cached texture belongs to it and the
+// cache must be cleared before that renderer is destroyed.
+class Asset_cache {
+    private:
+	static inline std::unordered_map<std::string, SDL::Texture> textures{};
+	static inline std::unordered_map<std::string, std::shared_ptr<void> > objects{};
+
+    public:
+	static SDL::Texture texture(SDL::Renderer &renderer, const std::string &path)
+	{
+		auto it = textures.find(path);
+		if (it == textures.end())
+			it = textures.emplace(path, SDL::Texture(renderer, Asset_archive::load(path))).first;
+		return it->second;
+	}
+
+	static std::optional<SDL::Texture> find(const std::string &path)
+	{
+		auto it = textures.find(path);
+		if (it == textures.end())
+			return std::nullopt;
+		return it->second;
+	}
+
+	// Registers a texture that was not loaded from path itself, e.g. generated at startup.
+	static SDL::Texture insert(const std::string &path, const SDL::Texture &texture)
+	{
+		return textures.insert_or_assign(path, texture).first->second;
+	}
+
+	// Returns the object cached under key, building it with generate() the first time.
+	template <typename T, typename F> static std::shared_ptr<T> shared(const std::string &key, F &&generate)
+	{
+		auto it = objects.find(key);
+		if (it == objects.end())
+			it = objects.emplace(key, std::shared_ptr<T>(generate())).first;
+		return std::static_pointer_cast<T>(it->second);
+	}
+
+	// Loads every file not cached yet. Decoding the images (when they are not in the
+	// archive) is the slow part and does not touch the renderer, so they are decoded
+	// in parallel and only the textures are created here, on the render thread.
+	static void preload(SDL::Renderer &renderer, const std::vector<std::string> &paths)
+	{
+		std::vector<std::pair<std::string, std::future<SDL::Surface> > > pending;
+		for (const auto &path : paths) {
+			if (textures.contains(path))
+				continue;
+			auto decode = [path] { return Asset_archive::load(path); };
+			pending.emplace_back(path, std::async(std::launch::async, decode));
+		}
+		for (auto &[path, surface] : pending)
+			textures.emplace(path, SDL::Texture(renderer, surface.get()));
+	}
+
+	static void evict(const std::string &key)
+	{
+		textures.erase(key);
+		objects.erase(key);
+	}
+
+	// Drops the assets nobody but the cache holds anymore.
+	static void evict_unused()
+	{
+		std::erase_if(textures, [](const auto &entry) { return entry.second.useCount() == 1; });
+		std::erase_if(objects, [](const auto &entry) { return entry.second.use_count() == 1; });
+	}
+
+	static void clear()
+	{
+		objects.clear();
+		textures.clear();
+	}
+};
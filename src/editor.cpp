@@ -3,12 +3,12 @@
 #include "exception.h"
 #include "game.h"
 #include "logic.h"
-#include "mainscreen.h"
+#include "pacer.h"
 #include "sdl.h"
+#include "states.h"
 #include "widget.h"
 
 #include <ctime>
-#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -16,9 +16,9 @@
 #include <sstream>
 
 struct Render_visitor {
-	SDL::Renderer &renderer;
+	Sprite_batch &batch;
 	const Assets &assets;
-	const Logic &logic;
+	const SDL::Rect &clip;
 
 	void operator()(const auto &)
 	{
@@ -27,33 +27,46 @@ struct Render_visitor {
 	void operator()(const Brick &brick)
 	{
 		constexpr int max_durability = 5;
-		constexpr int dim = 96;
 
-		int off = max_durability - static_cast<int>(brick.get_durability());
+		if (!SDL::hasIntersection(clip, brick_cell(brick)))
+			return;
 
-		SDL::Rect src = { off * dim, 0, dim, dim };
+		int off = max_durability - static_cast<int>(brick.get_durability());
 
-		float x = brick.get_x() - dim * 0.5;
-		float y = brick.get_y() - dim * 0.5;
+		float x = brick.get_x() - brick_dim * 0.5;
+		float y = brick.get_y() - brick_dim * 0.5;
 
-		SDL::FRect dst = { x, y, dim, dim };
 		switch (brick.get_form()) {
 		case Brick::rect:
-			return renderer.copy(assets.brick_rect, src, dst);
+			return assets.draw(batch, assets.brick_rect, off, x, y);
 		case Brick::hex:
-			return renderer.copy(assets.brick_hex, src, dst);
+			return assets.draw(batch, assets.brick_hex, off, x, y);
 		}
 	}
 };
 
+void Editor::on_enter()
+{
+	for (auto i = canva.get_bricks().size(); i > 0; i--)
+		canva.remove_brick(i - 1);
+	clicked_brick = std::nullopt;
+	exit_hover = save_hover = false;
+	dirty.assign(1, { 0, 0, scene_w, scene_h });
+}
+
 std::shared_ptr<State> Editor::operator()()
 {
 	float x = 0, y = 0;
-	bool is_redraw_needed = true;
 	bool is_left_pressed = false;
 
 	for (;;) {
-		auto event = SDL::waitEvent();
+		auto event = Frame_pacer::next_event();
+
+		// only the latest position matters, fold the queued motion events into one update
+		if (event.type == SDL_MOUSEMOTION) {
+			if (auto last = SDL::takeLastEvent(SDL_MOUSEMOTION))
+				event = *last;
+		}
 
 		is_left_pressed = SDL::isPressedMouse(SDL_BUTTON_LMASK);
 		if (!is_left_pressed)
@@ -68,62 +81,94 @@ std::shared_ptr<State> Editor::operator()()
 			if (is_left_pressed) {
 				drag(x, y);
 			}
-			is_redraw_needed = true;
 			break;
 		case SDL_MOUSEBUTTONDOWN:
 			x = event.motion.x;
 			y = event.motion.y;
 			if (exit.is_over(x, y))
-				return std::make_shared<MainScreen>(window, renderer);
+				return states.main_screen;
 			if (event.button.button == SDL_BUTTON_LEFT)
 				on_left_click(x, y);
 			if (event.button.button == SDL_BUTTON_RIGHT)
 				on_right_click(x, y);
-			is_redraw_needed = true;
+			break;
+		case SDL_RENDER_TARGETS_RESET:
+		case SDL_RENDER_DEVICE_RESET:
+			mark({ 0, 0, scene_w, scene_h });
 			break;
 		}
 
-		if (is_redraw_needed) {
-			is_redraw_needed = false;
-			draw(x, y);
-		}
+		draw(x, y);
 	}
 }
 
 void Editor::draw(float x, float y)
 {
-	renderer.clear();
+	if (exit.is_over(x, y) != exit_hover) {
+		exit_hover = !exit_hover;
+		mark(exit.get_rect());
+	}
+	if (save.is_over(x, y) != save_hover) {
+		save_hover = !save_hover;
+		mark(save.get_rect());
+	}
+
+	if (dirty.empty())
+		return;
+
+	if (dirty.size() > max_dirty) {
+		SDL::Rect box = dirty.front();
+		for (const auto &r : dirty)
+			box = SDL::unionRect(box, r);
+		dirty.assign(1, box);
+	}
+
+	renderer.setTarget(scene);
+	for (const auto &rect : dirty)
+		redraw(rect, x, y);
+	renderer.resetClipRect();
+	renderer.resetTarget();
+	dirty.clear();
+
+	renderer.copy(scene, { 0, 0, scene_w, scene_h }, SDL::Rect{ 0, 0, scene_w, scene_h });
+	renderer.present();
+}
+
+void Editor::redraw(const SDL::Rect &clip, float x, float y)
+{
+	renderer.setClipRect(clip);
+
+	renderer.setDrawBlendMode(SDL_BLENDMODE_NONE);
+	renderer.setDrawColor(0, 0, 0, 255);
+	renderer.fillRect(clip);
+	renderer.setDrawBlendMode(SDL_BLENDMODE_BLEND);
 
-	SDL::Rect src_bg = { 0, 0, assets.bg.getWidth(), assets.bg.getHeight() };
-	SDL::FRect dst_bg = { 0, 0, static_cast<float>(src_bg.w), static_cast<float>(src_bg.h) };
+	const float bg_w = static_cast<float>(assets.bg.w), bg_h = static_cast<float>(assets.bg.h);
 
-	for (dst_bg.y = 0; dst_bg.y < 400; dst_bg.y += src_bg.h) {
-		for (dst_bg.x = 0; dst_bg.x < 400; dst_bg.x += src_bg.w)
-			renderer.copy(assets.bg, src_bg, dst_bg);
+	for (float by = 0; by < scene_h; by += bg_h) {
+		for (float bx = 0; bx < scene_w; bx += bg_w)
+			assets.atlas.draw(batch, assets.bg, bx, by);
 	}
 
-	canva.visit(Render_visitor{ renderer, assets, canva });
+	canva.visit(Render_visitor{ batch, assets, clip });
+	batch.flush();
 
 	renderer.setDrawColor(255, 0, 0, 25);
 	SDL::FRect filter = { 0, canva.get_height() - 50, canva.get_width(), 50 };
 	renderer.fillRect(filter);
 
 	constexpr int dim_x = 128;
-	constexpr int dim_y = 512;
-
-	SDL::Rect src = { 0, 0, dim_x, dim_y };
-	SDL::Rect dst = { 400 - dim_x, 0, dim_x, dim_y };
 
-	renderer.copy(assets.ui, src, dst);
+	assets.atlas.draw(batch, assets.ui, 400 - dim_x, 0);
+	batch.flush();
 
 	for (Material &a : sources) {
-		a.draw(renderer);
+		if (SDL::hasIntersection(clip, a.get_cell()))
+			a.draw(renderer);
 	}
 
 	exit.draw(renderer, exit.is_over(x, y));
 	save.draw(renderer, save.is_over(x, y));
-
-	renderer.present();
 }
 
 void Editor::on_left_click(float x, float y)
@@ -136,6 +181,7 @@ void Editor::on_left_click(float x, float y)
 	}
 
 	if (idx_brick) {
+		mark(brick_cell(idx_brick->second));
 		clicked_brick = idx_brick->first;
 		click_offset_x = idx_brick->second.get_x() - x;
 		click_offset_y = idx_brick->second.get_y() - y;
@@ -143,6 +189,8 @@ void Editor::on_left_click(float x, float y)
 
 	for (unsigned int i = 0; i < sources.size(); i++) {
 		if (sources[i].is_over(x, y)) {
+			mark(sources[source].get_cell());
+			mark(sources[i].get_cell());
 			sources[source].set_selected(false);
 			sources[i].set_selected(true);
 			source = i;
@@ -157,15 +205,18 @@ void Editor::on_left_click(float x, float y)
 		oss << std::put_time(&tm, "%d-%m-%Y-%H-%M-%S");
 		auto time = oss.str();
 
-		std::ofstream out("save/save_" + time + ".save", std::ios::out);
-		canva.save(out);
-		out.close();
+		try {
+			canva.save("save/save_" + time + ".save");
+		} catch (Save_error const &) {
+			std::cerr << "Could not save the level to save/save_" << time << ".save" << std::endl;
+		}
 	}
 }
 
 void Editor::on_right_click(float x, float y)
 {
 	if (auto idx = canva.get_brick(x, y)) {
+		mark(brick_cell(idx->second));
 		canva.remove_brick(idx->first);
 	}
 }
@@ -181,5 +232,7 @@ void Editor::drag(float x, float y)
 	if (!is_in_canva(new_x, new_y))
 		return;
 
+	mark(brick_cell(canva.get_brick(*clicked_brick)));
 	canva.replace_brick_safe(*clicked_brick, new_x, new_y);
+	mark(brick_cell(canva.get_brick(*clicked_brick)));
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "batch.h"
 #include "fsm.h"
 #include "game.h"
 #include "logic.h"
@@ -7,17 +8,23 @@
 #include "widget.h"
 
 #include <array>
+#include <cstddef>
 #include <memory>
 #include <optional>
 #include <string>
+#include <vector>
+
+class States;
 
 // The Editor class is similar as the Game class, but it is responsible for
-// the editor logic.
+// the editor logic. Built once, see States: the atlas, the labels and the scene
+// target are kept, but every visit starts an empty level.
 class Editor : public State {
     public:
-	Editor(const SDL::Window &w, const SDL::Renderer &r)
+	Editor(const SDL::Window &w, const SDL::Renderer &r, States &states)
 		: window(w)
 		, renderer(r)
+		, states(states)
 		, assets{ renderer }
 		, exit("Exit", font, fg_color, hl_color, renderer, 325, 15)
 		, save("Save", font, fg_color, hl_color, renderer, 325, 258)
@@ -26,11 +33,14 @@ class Editor : public State {
 			    Material{ renderer, 1, false, 325, 210 } })
 		, canva(300, 300, false){};
 
-	std::shared_ptr<State> operator()();
+	void on_enter() override;
+
+	std::shared_ptr<State> operator()() override;
 
     private:
 	SDL::Window window;
 	SDL::Renderer renderer;
+	States &states;
 
 	Assets assets;
 	static inline SDL::Font font{ "assets/ticketing.regular.ttf", 30 };
@@ -43,8 +53,23 @@ class Editor : public State {
 	unsigned int source = 0;
 
 	Logic canva;
+	Sprite_batch batch{ renderer };
+
+	// The scene is kept in a render target and only the regions marked dirty
+	// since the last frame are redrawn into it.
+	static constexpr int scene_w = 400, scene_h = 300;
+	static constexpr std::size_t max_dirty = 16;
+	SDL::Texture scene{ renderer, SDL_TEXTUREACCESS_TARGET, scene_w, scene_h };
+	std::vector<SDL::Rect> dirty{ { 0, 0, scene_w, scene_h } };
+	bool exit_hover = false, save_hover = false;
+
+	void mark(const SDL::Rect &rect)
+	{
+		dirty.push_back(rect);
+	}
 
 	void draw(float x, float y);
+	void redraw(const SDL::Rect &clip, float x, float y);
 
 	void on_left_click(float x, float y);
 	void on_right_click(float x, float y);
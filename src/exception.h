@@ -4,3 +4,4 @@
 
 class Close : public std::exception {};
 class Bad_format : public std::exception {};
+class Save_error : public std::exception {};
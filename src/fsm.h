@@ -1,12 +1,21 @@
 #pragma once
 
 #include <memory>
+#include <utility>
 
 // State: Abstract base class for FSM states.
 // operator() should be overridden to implement transition logic.
+// States built once and returned again by later transitions reset what belongs
+// to a single visit in on_enter(), and may release it in on_exit().
 class State {
     public:
 	virtual std::shared_ptr<State> operator()() = 0;
+	virtual void on_enter()
+	{
+	}
+	virtual void on_exit()
+	{
+	}
 	virtual ~State() = default;
 };
 
@@ -18,10 +27,16 @@ class FSM {
 	FSM(std::shared_ptr<State> initial)
 		: current(initial)
 	{
+		current->on_enter();
 	}
 	void step()
 	{
-		current = (*current)();
+		auto next = (*current)();
+		if (next == current)
+			return;
+		current->on_exit();
+		current = std::move(next);
+		current->on_enter();
 	}
 	void run()
 	{
@@ -2,19 +2,172 @@
 
 #include "exception.h"
 #include "logic.h"
-#include "mainscreen.h"
 #include "sdl.h"
+#include "states.h"
 #include "widget.h"
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
 #include <memory>
 #include <optional>
 #include <string>
 #include <utility>
 
+// Sprite frame of a brick at the given tick, -1 once its destruction animation is over.
+static int brick_frame(const Brick &brick, int tick)
+{
+	constexpr int max_dura = 5;
+
+	if (brick.get_durability() == 0) {
+		int anim = (tick - brick.get_last_hit()) / 4;
+		if (anim >= 6)
+			return -1;
+		return 4 + anim;
+	}
+	return max_dura - static_cast<int>(brick.get_durability());
+}
+
+static void draw_brick(Sprite_batch &batch, const Assets &assets, const Brick &brick, int frame)
+{
+	float x = brick.get_x() - brick_dim / 2.;
+	float y = brick.get_y() - brick_dim / 2.;
+
+	switch (brick.get_form()) {
+	case Brick::rect:
+		return assets.draw(batch, assets.brick_rect, frame, x, y);
+	case Brick::hex:
+		return assets.draw(batch, assets.brick_hex, frame, x, y);
+	}
+}
+
+void Field_cache::update(SDL::Renderer &renderer, Sprite_batch &batch, const Assets &assets, const Logic &logic)
+{
+	auto bricks = logic.get_bricks();
+
+	dirty.clear();
+	if (frames.size() != bricks.size()) {
+		frames.assign(bricks.size(), -1);
+		dirty.push_back({ 0, 0, w, h });
+	}
+
+	for (std::size_t i = 0; i < bricks.size(); i++) {
+		int frame = brick_frame(bricks[i], logic.get_tick());
+		if (frame == frames[i])
+			continue;
+		frames[i] = frame;
+		dirty.push_back(brick_cell(bricks[i]));
+	}
+
+	if (dirty.empty())
+		return;
+
+	// past a handful of regions, one bounding box is cheaper than many clipped passes
+	if (dirty.size() > max_dirty) {
+		SDL::Rect box = dirty.front();
+		for (const auto &r : dirty)
+			box = SDL::unionRect(box, r);
+		dirty.assign(1, box);
+	}
+
+	batch.flush();
+	renderer.setTarget(texture);
+
+	const float bg_w = static_cast<float>(assets.bg.w), bg_h = static_cast<float>(assets.bg.h);
+	for (const auto &rect : dirty) {
+		renderer.setClipRect(rect);
+
+		renderer.setDrawBlendMode(SDL_BLENDMODE_NONE);
+		renderer.setDrawColor(0, 0, 0, 0);
+		renderer.fillRect(rect);
+		renderer.setDrawBlendMode(SDL_BLENDMODE_BLEND);
+
+		for (float y = 0; y < static_cast<float>(h); y += bg_h) {
+			for (float x = 0; x < static_cast<float>(w); x += bg_w)
+				assets.atlas.draw(batch, assets.bg, x, y);
+		}
+
+		for (std::size_t i = 0; i < bricks.size(); i++) {
+			if (frames[i] >= 0 && SDL::hasIntersection(rect, brick_cell(bricks[i])))
+				draw_brick(batch, assets, bricks[i], frames[i]);
+		}
+		batch.flush();
+	}
+
+	renderer.resetClipRect();
+	renderer.resetTarget();
+}
+
+// a few pixels from the middle of a frame, as particle texture
+static SDL::Rect frame_center(const Atlas::Frame &frame, int size)
+{
+	return { frame.src.x + frame.src.w / 2 - size / 2, frame.src.y + frame.src.h / 2 - size / 2, size, size };
+}
+
+Effects::Effects(const Assets &assets)
+	: particles(assets.atlas.get_texture())
+	, debris{ particles.add_sprite(frame_center(assets.brick_rect[0], 8)), 20, 90, 0.4, 0.9, 2, 5, 200,
+		  { 200, 180, 160, 255 } }
+	, spark{ particles.add_sprite(frame_center(assets.ball[0], 4)), 40, 140, 0.1, 0.3, 1, 3, 0,
+		 { 255, 230, 150, 255 } }
+	, trail{ particles.add_sprite(frame_center(assets.powerups[0], 4)), 2, 10, 0.2, 0.4, 1, 3, -20,
+		 { 150, 220, 255, 160 } }
+{
+}
+
+struct TrailVisitor {
+	Particles &particles;
+	const Particles::Style &style;
+
+	void operator()(const auto &)
+	{
+	}
+
+	void operator()(const Powerup &powerup)
+	{
+		if (powerup.is_alive())
+			particles.burst(powerup.get_x(), powerup.get_y(), 1, style);
+	}
+};
+
+void Effects::emit(Logic &logic)
+{
+	for (const auto &impact : logic.get_impacts()) {
+		switch (impact.kind) {
+		case Logic::Impact::brick_destroyed:
+			particles.burst(impact.x, impact.y, 24, debris);
+			particles.burst(impact.x, impact.y, 8, spark);
+			break;
+		case Logic::Impact::brick_hit:
+			particles.burst(impact.x, impact.y, 6, spark);
+			break;
+		case Logic::Impact::paddle:
+			particles.burst(impact.x, impact.y, 4, spark);
+			break;
+		}
+	}
+	logic.visit(TrailVisitor{ particles, trail });
+}
+
+static void play_impacts(Audio &audio, const Logic &logic)
+{
+	for (const auto &impact : logic.get_impacts()) {
+		switch (impact.kind) {
+		case Logic::Impact::brick_destroyed:
+			audio.play(Audio::brick_break);
+			break;
+		case Logic::Impact::brick_hit:
+			audio.play(Audio::brick_hit);
+			break;
+		case Logic::Impact::paddle:
+			audio.play(Audio::bounce);
+			break;
+		}
+	}
+}
+
 struct RenderVisitor {
-	SDL::Renderer &renderer;
+	Sprite_batch &batch;
 	const Assets &assets;
 	const Logic &logic;
 
@@ -31,38 +184,7 @@ struct RenderVisitor {
 
 		int off = powerup.get_power();
 
-		SDL::Rect src = { off * dim, 0, dim, dim };
-		SDL::FRect dst = { powerup.get_x() - dim / 2.f, powerup.get_y() - dim / 2.f, dim, dim };
-		renderer.copy(assets.powerups, src, dst);
-	}
-
-	void operator()(const Brick &brick)
-	{
-		constexpr int max_dura = 5;
-		constexpr int dim = 96;
-
-		int off = 0;
-		if (brick.get_durability() == 0) {
-			int anim = (logic.get_tick() - brick.get_last_hit()) / 4;
-			if (anim >= 6)
-				return;
-			off = 4 + anim;
-		} else {
-			off = max_dura - static_cast<int>(brick.get_durability());
-		}
-
-		SDL::Rect src = { off * dim, 0, dim, dim };
-
-		float x = brick.get_x() - dim / 2.;
-		float y = brick.get_y() - dim / 2.;
-
-		SDL::FRect dst = { x, y, dim, dim };
-		switch (brick.get_form()) {
-		case Brick::rect:
-			return renderer.copy(assets.brick_rect, src, dst);
-		case Brick::hex:
-			return renderer.copy(assets.brick_hex, src, dst);
-		}
+		assets.draw(batch, assets.powerups, off, powerup.get_x() - dim / 2.f, powerup.get_y() - dim / 2.f);
 	}
 
 	void operator()(const Ball &ball)
@@ -71,12 +193,9 @@ struct RenderVisitor {
 
 		int off = logic.get_tick() / 4 % 8;
 
-		SDL::Rect src = { off * dim, 0, dim, dim };
-
 		float x = ball.get_x() - dim * 0.5;
 		float y = ball.get_y() - dim * 0.5;
-		SDL::FRect dst = { x, y, dim, dim };
-		renderer.copy(assets.ball, src, dst);
+		assets.draw(batch, assets.ball, off, x, y);
 	}
 
 	void operator()(const Paddle &paddle)
@@ -85,31 +204,25 @@ struct RenderVisitor {
 
 		int off = 7;
 
-		SDL::Rect src = { dim * off, 0, dim, dim };
-
 		float x = paddle.get_x() - dim * 0.5;
 		float y = paddle.get_y() - dim * 0.5;
 
-		SDL::FRect dst = { x, y, dim, dim };
-		renderer.copy(assets.paddle, src, dst);
+		assets.draw(batch, assets.paddle, off, x, y);
 
 		off = logic.get_tick() / 4 % 8;
 
-		dst.y += 4;
+		y += 4;
 
 		switch (paddle.get_dir()) {
 		case Paddle::left:
-			src = { dim * (off + 1), 0, dim, dim };
-			renderer.copy(assets.ship_left, src, dst);
+			assets.draw(batch, assets.ship_left, off + 1, x, y);
 			break;
 		case Paddle::right: {
-			src = { dim * (off + 1), 0, dim, dim };
-			renderer.copy(assets.ship_right, src, dst);
+			assets.draw(batch, assets.ship_right, off + 1, x, y);
 			break;
 		}
 		default: {
-			src = { 0, 0, dim, dim };
-			renderer.copy(assets.ship, src, dst);
+			assets.draw(batch, assets.ship, 0, x, y);
 			break;
 		}
 		}
@@ -120,11 +233,28 @@ struct RenderVisitor {
 	}
 };
 
-std::shared_ptr<State> Game::operator()()
+Paddle::dir Game::steer(const Input::State &controls, std::size_t player)
 {
-	std::optional<std::pair<int, int> > mouse_pos = std::make_pair(0, 0);
-	mouse_pos = std::nullopt;
+	if (controls.left && !controls.right)
+		return Paddle::left;
+	if (!controls.left && controls.right)
+		return Paddle::right;
+	if (!controls.mouse_x)
+		return Paddle::none;
+
+	float margin = 10;
+	float x = static_cast<float>(*controls.mouse_x);
+	if (x < logic.get_paddle(player).get_x() - margin)
+		return Paddle::left;
+	if (x > logic.get_paddle(player).get_x() + margin)
+		return Paddle::right;
+	return Paddle::none;
+}
 
+std::shared_ptr<State> Game::operator()()
+{
+	pacer.reset();
+	input.skip();
 	for (;;) {
 		while (auto event = SDL::pollEvent()) {
 			switch (event->type) {
@@ -137,95 +267,106 @@ std::shared_ptr<State> Game::operator()()
 						// quit to the menu
 						return *state;
 					}
+					// the time spent paused is not simulated
+					pacer.reset();
+					input.skip();
 					break;
 				case SDLK_SPACE:
-					logic.launch_ball();
+					if (view)
+						break;
+					if (session)
+						launch = true;
+					else
+						logic.launch_ball();
 					break;
 				};
 				break;
-			case SDL_MOUSEMOTION:
-				mouse_pos = std::make_pair(event->motion.x, event->motion.y);
+			case SDL_RENDER_TARGETS_RESET:
+			case SDL_RENDER_DEVICE_RESET:
+				reset_textures();
 				break;
 			}
 		}
 
-		logic.step(16.f / 1000);
-
-		if (logic.get_state() != Logic::GameState::RUNNING) {
-			return end();
+		if (view) {
+			// the host simulates, the stream replaces the state
+			auto result = view->update(logic);
+			if (result == Spectator_view::lost) {
+				SDL::warn("Lost the connection to the host");
+				return states.main_screen;
+			}
+			// a snapshot may move bricks without changing their number
+			if (result == Spectator_view::resynced)
+				field.invalidate();
+			if (logic.get_state() != Logic::GameState::RUNNING)
+				return end();
 		}
 
-		bool is_left_pressed = SDL::isPressed(SDL_SCANCODE_LEFT);
-		bool is_right_pressed = SDL::isPressed(SDL_SCANCODE_RIGHT);
-
-		if (is_left_pressed && !is_right_pressed) {
-			logic.set_paddle_dir(Paddle::left);
-			mouse_pos = std::nullopt;
-		} else if (!is_left_pressed && is_right_pressed) {
-			logic.set_paddle_dir(Paddle::right);
-			mouse_pos = std::nullopt;
-		} else if (mouse_pos) {
-			float margin = 10;
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wmaybe-uninitialized" // GCC false positive
-			if (mouse_pos->first < logic.get_paddle().get_x() - margin) {
-				logic.set_paddle_dir(Paddle::left);
-			} else if (mouse_pos->first > logic.get_paddle().get_x() + margin) {
-				logic.set_paddle_dir(Paddle::right);
-#pragma GCC diagnostic pop
+		// each tick sees the controls as they were at its own time, not at the start of the frame
+		for (int n = view ? 0 : pacer.ticks(), k = 0; k < n; k++) {
+			const auto &controls = input.advance(pacer.tick_time(k));
+			if (session) {
+				std::size_t player = session->get_player();
+				if (session->needs_input())
+					session->input({ steer(controls, player), std::exchange(launch, false) });
+				// waiting for the peer, the remaining ticks of the frame are not simulated
+				if (!session->step(logic))
+					break;
+				if (auto tick = session->get_desync(); tick && !std::exchange(desync_reported, true))
+					SDL::warn("Multiplayer game out of sync since tick " + std::to_string(*tick));
 			} else {
-				logic.set_paddle_dir(Paddle::none);
+				logic.set_paddle_dir(steer(controls));
+				logic.step(Frame_pacer::tick);
+			}
+			if (states.server)
+				states.server->publish(logic);
+			effects.emit(logic);
+			effects.update(Frame_pacer::tick);
+			play_impacts(*audio, logic);
+
+			if (logic.get_state() != Logic::GameState::RUNNING) {
+				return end();
 			}
-		} else {
-			logic.set_paddle_dir(Paddle::none);
 		}
 
-		draw();
+		if (session && session->peer_lost()) {
+			SDL::warn("The other player left the game");
+			return states.main_screen;
+		}
 
-		renderer.present();
+		draw();
 
-		SDL::delay(16);
+		pacer.present(renderer);
+		input.presented(Frame_pacer::clock());
 	}
 }
 
 void Game::draw()
 {
-	SDL::Rect src_bg = { 0, 0, assets.bg.getWidth(), assets.bg.getHeight() };
-	SDL::FRect dst_bg = { 0, 0, static_cast<float>(src_bg.w), static_cast<float>(src_bg.h) };
+	// background and bricks come from the cached layer, only moving objects are redrawn
+	field.update(renderer, batch, assets, logic);
+	field.draw(batch);
 
-	for (dst_bg.y = 0; dst_bg.y < 400; dst_bg.y += src_bg.h) {
-		for (dst_bg.x = 0; dst_bg.x < 400; dst_bg.x += src_bg.w)
-			renderer.copy(assets.bg, src_bg, dst_bg);
-	}
+	batch.flush();
+	effects.draw(renderer);
 
-	logic.visit(RenderVisitor{ renderer, assets, logic });
+	logic.visit(RenderVisitor{ batch, assets, logic });
 
 	constexpr int ball_dim = 32;
 	constexpr int dim_x = 128;
-	constexpr int dim_y = 512;
-
-	SDL::Rect src = { 0, 0, dim_x, dim_y };
-	SDL::Rect dst = { 400 - dim_x, 0, dim_x, dim_y };
 
-	renderer.copy(assets.ui, src, dst);
-
-	SDL::Texture score =
-		ui_factory.create_label(renderer, std::to_string(logic.get_score()), { 255, 255, 255, 255 });
-
-	SDL::Rect score_src = score.getRect();
-	SDL::FRect score_dst = { 350.f - score_src.w * 0.5f, 30.f - score_src.h * 0.5f, static_cast<float>(score_src.w),
-				 static_cast<float>(score_src.h) };
-
-	SDL::Rect ball_src = { 0, 0, ball_dim, ball_dim };
-	SDL::FRect ball_dst = { 330.f - ball_dim * 0.5f, 272 - ball_dim * 0.5f, static_cast<float>(ball_src.w),
-				static_cast<float>(ball_src.h) };
-
-	renderer.copy(score, score_src, score_dst);
+	assets.atlas.draw(batch, assets.ui, 400 - dim_x, 0);
 
 	for (int i = 0; i < std::min(logic.get_lives(), 2); ++i) {
-		ball_dst.x = 340.f - ball_dim * 0.5f + i * 48.f / 2.f;
-		renderer.copy(assets.ball, ball_src, ball_dst);
+		float x = 340.f - ball_dim * 0.5f + i * 48.f / 2.f;
+		assets.draw(batch, assets.ball, 0, x, 272 - ball_dim * 0.5f);
 	}
+
+	const SDL::Color white = { 255, 255, 255, 255 };
+	ui_factory->get_glyphs().draw_centered(batch, std::to_string(logic.get_score()), 350, 30, white);
+
+	// everything above goes out in one geometry call per texture
+	batch.flush();
 }
 
 struct Button {
@@ -263,6 +404,43 @@ struct Element {
 	}
 };
 
+SDL::Texture Game::snapshot(bool darken)
+{
+	SDL::Texture frame(renderer, SDL_TEXTUREACCESS_TARGET, 400, 300);
+	frame.setBlendMode(SDL_BLENDMODE_NONE);
+
+	// bring the cached field up to date first so that draw() does not switch targets
+	field.update(renderer, batch, assets, logic);
+
+	renderer.setTarget(frame);
+	draw();
+	if (darken) {
+		renderer.setDrawColor(0, 0, 0, 128);
+		renderer.fillRect(SDL::Rect{ 0, 0, 400, 300 });
+	}
+	renderer.resetTarget();
+
+	return frame;
+}
+
+void Game::reset_textures()
+{
+	ui_factory->invalidate(renderer);
+	field.invalidate();
+}
+
+SDL::Event Game::overlay_event()
+{
+	if (!session)
+		return Frame_pacer::next_event();
+	// the peer takes a silent session for a gone player, wake up to poll it
+	for (;;) {
+		session->poll();
+		if (auto event = SDL::waitEventTimeout(100))
+			return *event;
+	}
+}
+
 std::optional<std::shared_ptr<State> > Game::pause()
 {
 	int spacing = 30;
@@ -271,12 +449,12 @@ std::optional<std::shared_ptr<State> > Game::pause()
 	int button_height = 25;
 
 	std::array<Button, 3> buttons = {
-		{ { ui_factory.create_button(renderer, "RESUME", button_width, button_height),
-		    ui_factory.create_button_over(renderer, "RESUME", button_width, button_height) },
-		  { ui_factory.create_button(renderer, "RESTART", button_width, button_height),
-		    ui_factory.create_button_over(renderer, "RESTART", button_width, button_height) },
-		  { ui_factory.create_button(renderer, "QUIT", button_width, button_height),
-		    ui_factory.create_button_over(renderer, "QUIT", button_width, button_height) } }
+		{ { ui_factory->create_button(renderer, "RESUME", button_width, button_height),
+		    ui_factory->create_button_over(renderer, "RESUME", button_width, button_height) },
+		  { ui_factory->create_button(renderer, "RESTART", button_width, button_height),
+		    ui_factory->create_button_over(renderer, "RESTART", button_width, button_height) },
+		  { ui_factory->create_button(renderer, "QUIT", button_width, button_height),
+		    ui_factory->create_button_over(renderer, "QUIT", button_width, button_height) } }
 	};
 
 	int box_width = 100;
@@ -288,41 +466,44 @@ std::optional<std::shared_ptr<State> > Game::pause()
 				   150 - box_height / 2 + static_cast<int>(i) * (spacing) + spacing / 2, src.w, src.h };
 	};
 
-	Element box(ui_factory.create_big_box(renderer, box_width, box_height));
+	Element box(ui_factory->create_big_box(renderer, box_width, box_height));
 	box.dst = { 200 - box_width / 2, 150 - box_height / 2, box_width, box_height };
 
-	Element title(ui_factory.create_button(renderer, "PAUSED"));
+	Element title(ui_factory->create_button(renderer, "PAUSED"));
 	title.dst = { 200 - title.src.w / 2, box.dst.y - title.src.h / 2, title.src.w, title.src.h };
 
+	// the game is frozen, its darkened last frame is captured once and reused
+	Element background(snapshot(true));
+	bool is_redraw_needed = true;
+
 	for (;;) {
-		// draw game as background
-		draw();
+		if (is_redraw_needed) {
+			is_redraw_needed = false;
 
-		// blur the game
-		renderer.setDrawColor(0, 0, 0, 128);
-		renderer.fillRect((SDL::Rect){ 0, 0, 400, 400 });
+			background.draw(renderer);
 
-		// draw pause menu
-		box.draw(renderer);
-		title.draw(renderer);
+			// draw pause menu
+			box.draw(renderer);
+			title.draw(renderer);
 
-		SDL::Point win;
-		SDL::getMouseState(win.x, win.y);
-		SDL::FPoint pos = renderer.windowToLogical(win);
+			SDL::Point win;
+			SDL::getMouseState(win.x, win.y);
+			SDL::FPoint pos = renderer.windowToLogical(win);
 
-		for (auto &button : buttons) {
-			if (button.contains(pos.x, pos.y)) {
-				button.draw_over(renderer);
-			} else {
-				button.draw(renderer);
+			for (auto &button : buttons) {
+				if (button.contains(pos.x, pos.y)) {
+					button.draw_over(renderer);
+				} else {
+					button.draw(renderer);
+				}
 			}
-		}
-
-		renderer.present();
 
-		SDL::delay(16);
+			renderer.present();
+		}
 
-		while (auto event = SDL::pollEvent()) {
+		// nothing moves on this screen, sleep until something happens and handle
+		// everything that piled up before drawing again
+		for (auto event = std::optional(overlay_event()); event; event = SDL::pollEvent()) {
 			switch (event->type) {
 			case SDL_QUIT:
 				throw Close();
@@ -331,22 +512,24 @@ std::optional<std::shared_ptr<State> > Game::pause()
 					return resume();
 				}
 				break;
+			case SDL_MOUSEMOTION:
+			case SDL_WINDOWEVENT:
+				is_redraw_needed = true;
+				break;
+			case SDL_RENDER_TARGETS_RESET:
+			case SDL_RENDER_DEVICE_RESET:
+				// the buttons hold textures that were lost, build the overlay again
+				reset_textures();
+				return pause();
 			case SDL_MOUSEBUTTONDOWN:
 				int x = event->button.x;
 				int y = event->button.y;
 				if (buttons[0].contains(x, y)) {
 					return resume();
 				} else if (buttons[1].contains(x, y)) {
-					if (!save_file.empty()) {
-						try {
-							return std::make_shared<Game>(window, renderer, save_file);
-						} catch (Bad_format const &) {
-							return std::make_shared<Game>(window, renderer);
-						}
-					}
-					return std::make_shared<Game>(window, renderer);
+					return new_game();
 				} else if (buttons[2].contains(x, y)) {
-					return std::make_shared<MainScreen>(window, renderer);
+					return states.main_screen;
 				}
 				break;
 			}
@@ -358,37 +541,57 @@ std::optional<std::shared_ptr<State> > Game::resume()
 {
 	int tick = 179;
 
-	for (;;) {
-		draw();
+	Element background(snapshot(false));
+	pacer.reset();
 
-		SDL::Texture counter =
-			ui_factory.create_label(renderer, std::to_string(tick / 60 + 1), { 255, 255, 255, 255 });
-		SDL::Rect src = { 0, 0, counter.getWidth(), counter.getHeight() };
+	for (;;) {
+		background.draw(renderer);
 
 		// simple scale animation
 		float scale = 2.5 - static_cast<float>(tick % 60) / 60;
-		float w = src.w * scale;
-		float h = src.h * scale;
-		SDL::FRect dst = { 150 - w / 2, 150 - h / 2, w, h };
+		ui_factory->get_glyphs().draw_centered(batch, std::to_string(tick / 60 + 1), 150, 150,
+						      { 255, 255, 255, 255 }, scale);
+		batch.flush();
 
-		renderer.copy(counter, src, dst);
+		pacer.present(renderer);
+		if (session)
+			session->poll();
 
-		renderer.present();
-
-		SDL::delay(16);
-
-		tick--;
-		if (tick == 0) {
+		tick -= pacer.ticks();
+		if (tick <= 0) {
 			// resume game
 			return std::nullopt;
 		}
 
-		while (auto event = SDL::pollEvent()) {
-			;
+		while (auto event = pacer.wait_event()) {
+			switch (event->type) {
+			case SDL_QUIT:
+				throw Close();
+			case SDL_RENDER_TARGETS_RESET:
+			case SDL_RENDER_DEVICE_RESET:
+				reset_textures();
+				background.texture = snapshot(false);
+				break;
+			}
 		}
 	}
 }
 
+std::shared_ptr<State> Game::new_game()
+{
+	// neither the peer nor the host can be restarted from here
+	if (session || view)
+		return states.main_screen;
+	if (!save_file.empty()) {
+		try {
+			return std::make_shared<Game>(window, renderer, states, save_file);
+		} catch (Bad_format const &) {
+			return std::make_shared<Game>(window, renderer, states);
+		}
+	}
+	return std::make_shared<Game>(window, renderer, states);
+}
+
 std::shared_ptr<State> Game::end()
 {
 	std::string title_text;
@@ -398,82 +601,92 @@ std::shared_ptr<State> Game::end()
 		title_text = "YOU LOSE";
 	}
 
-	Element title(ui_factory.create_button(renderer, title_text));
+	Element title(ui_factory->create_button(renderer, title_text));
 
 	int box_width = 120;
 	int box_height = 140;
 
-	Element box(ui_factory.create_big_box(renderer, box_width, box_height));
+	Element box(ui_factory->create_big_box(renderer, box_width, box_height));
 
 	box.dst = { 150 - box_width / 2, 150 - box_height / 2, box_width, box_height };
 	title.dst = { 150 - title.src.w / 2, box.dst.y - title.src.h / 2, title.src.w, title.src.h };
 
-	Element score_text(ui_factory.create_label(renderer, "Score :", { 255, 255, 255, 255 }));
+	Element score_text(ui_factory->create_label(renderer, "Score :", { 255, 255, 255, 255 }));
 	score_text.dst = { 150 - score_text.src.w / 2, box.dst.y + 16, score_text.src.w, score_text.src.h };
 
-	Element score(ui_factory.create_label(renderer, std::to_string(logic.get_score()), { 255, 255, 255, 255 }));
+	Element score(ui_factory->create_label(renderer, std::to_string(logic.get_score()), { 255, 255, 255, 255 }));
 	score.dst = { 150 - score.src.w / 2, score_text.dst.y + score_text.dst.h + 16, score.src.w, score.src.h };
 
-	Button home(ui_factory.create_home_button(renderer), ui_factory.create_home_button_over(renderer));
-	Button restart(ui_factory.create_restart_button(renderer), ui_factory.create_restart_button_over(renderer));
+	Button home(ui_factory->create_home_button(renderer), ui_factory->create_home_button_over(renderer));
+	Button restart(ui_factory->create_restart_button(renderer), ui_factory->create_restart_button_over(renderer));
 
 	int spacing = box.dst.w / 3;
 	home.dst = { box.dst.x + spacing - home.src.w / 2, box.dst.y + box.dst.h - 32, home.src.w, home.src.h };
 	restart.dst = { box.dst.x + 2 * spacing - restart.src.w / 2, box.dst.y + box.dst.h - 32, restart.src.w,
 			restart.src.h };
 
-	for (;;) { // draw game as background
-		draw();
+	// the game is over, its last frame is captured once and reused
+	Element background(snapshot(false));
+	bool is_redraw_needed = true;
 
-		// draw pause menu
-		box.draw(renderer);
-		title.draw(renderer);
+	for (;;) {
+		if (is_redraw_needed) {
+			is_redraw_needed = false;
 
-		score_text.draw(renderer);
-		score.draw(renderer);
+			background.draw(renderer);
 
-		// draw separator
-		renderer.setDrawColor(255, 255, 255, 255);
-		int y = home.dst.y - 16;
-		renderer.drawLine(box.dst.x + 10, y, box.dst.x + box.dst.w - 10, y);
+			// draw pause menu
+			box.draw(renderer);
+			title.draw(renderer);
 
-		SDL::Point win;
-		SDL::getMouseState(win.x, win.y);
-		SDL::FPoint log = renderer.windowToLogical(win);
+			score_text.draw(renderer);
+			score.draw(renderer);
 
-		if (home.contains(log.x, log.y)) {
-			home.draw_over(renderer);
-		} else {
-			home.draw(renderer);
-		}
-		if (restart.contains(log.x, log.y)) {
-			restart.draw_over(renderer);
-		} else {
-			restart.draw(renderer);
-		}
+			// draw separator
+			renderer.setDrawColor(255, 255, 255, 255);
+			int y = home.dst.y - 16;
+			renderer.drawLine(box.dst.x + 10, y, box.dst.x + box.dst.w - 10, y);
+
+			SDL::Point win;
+			SDL::getMouseState(win.x, win.y);
+			SDL::FPoint log = renderer.windowToLogical(win);
 
-		renderer.present();
+			if (home.contains(log.x, log.y)) {
+				home.draw_over(renderer);
+			} else {
+				home.draw(renderer);
+			}
+			if (restart.contains(log.x, log.y)) {
+				restart.draw_over(renderer);
+			} else {
+				restart.draw(renderer);
+			}
 
-		SDL::delay(16);
+			renderer.present();
+		}
 
-		while (auto event = SDL::pollEvent()) {
+		// nothing moves on this screen, sleep until something happens and handle
+		// everything that piled up before drawing again
+		for (auto event = std::optional(overlay_event()); event; event = SDL::pollEvent()) {
 			switch (event->type) {
 			case SDL_QUIT:
 				throw Close();
+			case SDL_MOUSEMOTION:
+			case SDL_WINDOWEVENT:
+				is_redraw_needed = true;
+				break;
+			case SDL_RENDER_TARGETS_RESET:
+			case SDL_RENDER_DEVICE_RESET:
+				// the buttons hold textures that were lost, build the overlay again
+				reset_textures();
+				return end();
 			case SDL_MOUSEBUTTONDOWN:
 				int x = event->button.x;
 				int y = event->button.y;
 				if (home.contains(x, y)) {
-					return std::make_shared<MainScreen>(window, renderer);
+					return states.main_screen;
 				} else if (restart.contains(x, y)) {
-					if (!save_file.empty()) {
-						try {
-							return std::make_shared<Game>(window, renderer, save_file);
-						} catch (Bad_format const &) {
-							return std::make_shared<Game>(window, renderer);
-						}
-					}
-					return std::make_shared<Game>(window, renderer);
+					return new_game();
 				}
 				break;
 			}
@@ -1,58 +1,195 @@
 #pragma once
 
+#include "atlas.h"
+#include "audio.h"
+#include "batch.h"
 #include "fsm.h"
+#include "input.h"
+#include "lockstep.h"
 #include "logic.h"
+#include "pacer.h"
+#include "particles.h"
 #include "sdl.h"
+#include "spectate.h"
 #include "widget.h"
 
+#include <cmath>
+#include <cstddef>
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
+// Assets: Gameplay sprites, resolved by name from the atlas once so that
+// drawing only indexes into the frame tables.
 struct Assets {
 	Assets(SDL::Renderer &renderer)
-		: brick_rect{ renderer, "assets/asteroid.png" }
-		, brick_hex{ renderer, "assets/hex.png" }
-		, ball{ renderer, "assets/ball.png" }
-		, powerups{ renderer, "assets/powerups.png" }
-		, paddle{ renderer, "assets/shield.png" }
-		, ship{ renderer, "assets/ship_forward.png" }
-		, ship_right{ renderer, "assets/ship_right.png" }
-		, ship_left{ renderer, "assets/ship_left.png" }
-		, ui{ renderer, "assets/side.png" }
-		, bg{ renderer, "assets/bg.png" } {};
-
-	SDL::Texture brick_rect;
-	SDL::Texture brick_hex;
-	SDL::Texture ball;
-	SDL::Texture powerups;
-	SDL::Texture paddle;
-	SDL::Texture ship;
-	SDL::Texture ship_right;
-	SDL::Texture ship_left;
-	SDL::Texture ui;
-	SDL::Texture bg;
+		: atlas{ renderer }
+		, brick_rect{ atlas.sheet("asteroid") }
+		, brick_hex{ atlas.sheet("hex") }
+		, ball{ atlas.sheet("ball") }
+		, powerups{ atlas.sheet("powerups") }
+		, paddle{ atlas.sheet("shield") }
+		, ship{ atlas.sheet("ship_forward") }
+		, ship_right{ atlas.sheet("ship_right") }
+		, ship_left{ atlas.sheet("ship_left") }
+		, ui{ atlas.frame("side:0") }
+		, bg{ atlas.frame("bg:0") } {};
+
+	Atlas atlas;
+
+	using Frames = std::vector<Atlas::Frame>;
+	Frames brick_rect;
+	Frames brick_hex;
+	Frames ball;
+	Frames powerups;
+	Frames paddle;
+	Frames ship;
+	Frames ship_right;
+	Frames ship_left;
+	Atlas::Frame ui;
+	Atlas::Frame bg;
+
+	// Draws frame `index` of `frames`, skipping indices the sheet does not have.
+	void draw(Sprite_batch &batch, const Frames &frames, int index, float x, float y) const
+	{
+		if (index < 0 || static_cast<std::size_t>(index) >= frames.size())
+			return;
+		atlas.draw(batch, frames[static_cast<std::size_t>(index)], x, y);
+	}
+};
+
+constexpr int brick_dim = 96;
+
+// Screen area covered by the sprite cell of a brick.
+inline SDL::Rect brick_cell(const Brick &brick)
+{
+	return { static_cast<int>(std::floor(brick.get_x() - brick_dim / 2.f)),
+		 static_cast<int>(std::floor(brick.get_y() - brick_dim / 2.f)), brick_dim, brick_dim };
+}
+
+// Field_cache: Render target holding the background and the bricks of the play field.
+// Bricks only change when they are hit, so each frame only the cells around bricks
+// whose sprite changed since the previous frame are redrawn.
+class Field_cache {
+    public:
+	Field_cache(SDL::Renderer &renderer, int w, int h)
+		: texture(renderer, SDL_TEXTUREACCESS_TARGET, w, h)
+		, w(w)
+		, h(h)
+	{
+		texture.setBlendMode(SDL_BLENDMODE_NONE);
+	}
+
+	// Brings the cached layer up to date with the bricks of logic.
+	void update(SDL::Renderer &renderer, Sprite_batch &batch, const Assets &assets, const Logic &logic);
+
+	void draw(Sprite_batch &batch) const
+	{
+		batch.draw(texture, { 0, 0, w, h }, { 0, 0, static_cast<float>(w), static_cast<float>(h) });
+	}
+
+	// Forces a full redraw, e.g. after the render targets were reset.
+	void invalidate()
+	{
+		frames.clear();
+	}
+
+    private:
+	static constexpr std::size_t max_dirty = 16;
+
+	SDL::Texture texture;
+	int w, h;
+
+	std::vector<int> frames{}; // sprite frame drawn for each brick, -1 when none
+	std::vector<SDL::Rect> dirty{};
+};
+
+// Effects: Particles spawned by the game: debris of destroyed bricks, sparks on
+// impacts and trails behind falling powerups.
+class Effects {
+    private:
+	Particles particles;
+	Particles::Style debris, spark, trail;
+
+    public:
+	Effects(const Assets &assets);
+
+	// Spawns the particles for what happened during the last logic step.
+	void emit(Logic &logic);
+
+	void update(float dt)
+	{
+		particles.update(dt);
+	}
+
+	void draw(SDL::Renderer &renderer)
+	{
+		particles.draw(renderer);
+	}
 };
 
+class States;
+
 // The Game class handle the interaction between the user and the game logic.
 // It is responsible for rendering the game and handling user input.
 class Game : public State {
     public:
-	Game(const SDL::Window &w, const SDL::Renderer &r)
+	Game(const SDL::Window &w, const SDL::Renderer &r, States &states)
 		: window(w)
 		, renderer(r)
+		, states(states)
 		, save_file()
 		, logic(300, 300, true)
 		, assets(renderer)
-		, ui_factory(renderer){};
+		, ui_factory(UI_Factory::shared(renderer)){};
 
-	Game(const SDL::Window &w, const SDL::Renderer &r, const std::string save_file)
+	Game(const SDL::Window &w, const SDL::Renderer &r, States &states, const std::string save_file)
 		: window(w)
 		, renderer(r)
+		, states(states)
 		, save_file(save_file)
 		, logic(Logic::load(save_file))
 		, assets{ renderer }
-		, ui_factory(renderer){};
+		, ui_factory(UI_Factory::shared(renderer)){};
+
+	// Takes over a level that has already been parsed, e.g. by a background load.
+	Game(const SDL::Window &w, const SDL::Renderer &r, States &states, const std::string save_file, Logic level)
+		: window(w)
+		, renderer(r)
+		, states(states)
+		, save_file(save_file)
+		, logic(std::move(level))
+		, assets{ renderer }
+		, ui_factory(UI_Factory::shared(renderer)){};
+
+	// Two player game on the default level, in lockstep with the peer of session.
+	Game(const SDL::Window &w, const SDL::Renderer &r, States &states, std::shared_ptr<Lockstep> session)
+		: window(w)
+		, renderer(r)
+		, states(states)
+		, save_file()
+		, logic(300, 300, true)
+		, assets(renderer)
+		, ui_factory(UI_Factory::shared(renderer))
+		, session(std::move(session))
+	{
+		logic.add_player();
+	}
+
+	// Watches the game streamed by a host, without playing.
+	Game(const SDL::Window &w, const SDL::Renderer &r, States &states, std::shared_ptr<Spectator_view> view)
+		: window(w)
+		, renderer(r)
+		, states(states)
+		, save_file()
+		, logic(300, 300)
+		, assets(renderer)
+		, ui_factory(UI_Factory::shared(renderer))
+		, view(std::move(view))
+	{
+	}
 
 	std::shared_ptr<State> operator()() override;
 	void draw();
@@ -60,16 +197,42 @@ class Game : public State {
     private:
 	SDL::Window window;
 	SDL::Renderer renderer;
+	States &states;
 
 	const std::string save_file;
 
 	Logic logic;
 	Assets assets;
-	UI_Factory ui_factory;
+	std::shared_ptr<UI_Factory> ui_factory;
+	Sprite_batch batch{ renderer };
+	Field_cache field{ renderer, 400, 300 };
+	Frame_pacer pacer{ window, renderer };
+	Effects effects{ assets };
+	std::shared_ptr<Audio> audio = Audio::shared();
+	Input input{};
+
+	std::shared_ptr<Lockstep> session{};
+	bool launch = false; // requested since the last input sent to the session
+	bool desync_reported = false;
+
+	std::shared_ptr<Spectator_view> view{};
+
+	// Direction the controls ask for the paddle of player.
+	Paddle::dir steer(const Input::State &controls, std::size_t player = 0);
+
+	// Still image of the current frame for the overlays, optionally darkened.
+	SDL::Texture snapshot(bool darken);
+
+	// Next event for the overlays, keeping the session alive while waiting for it.
+	SDL::Event overlay_event();
+
+	// Rebuilds the cached textures after SDL_RENDER_TARGETS_RESET or SDL_RENDER_DEVICE_RESET.
+	void reset_textures();
 
 	std::optional<std::shared_ptr<State> > pause();
 	std::optional<std::shared_ptr<State> > resume();
 	std::shared_ptr<State> end();
+	std::shared_ptr<State> new_game();
 
 	friend class Pause;
 };
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "pacer.h"
+#include "queue.h"
+#include "sdl.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <string>
+
+// Input: Paddle controls, timestamped as they arrive and applied at the tick they happened in.
+//
+// An event watch stamps every key and mouse motion event with Frame_pacer::clock()
+// when SDL pumps it from the system, which happens while the game polls its events,
+// and pushes it to a lock-free queue. Before each simulation tick, advance() applies
+// the inputs stamped up to that tick (see Frame_pacer::tick_time), and presented()
+// measures the poll to present latency: how long the first of them took from being
+// polled to reaching the screen. The time spent in the system queue before the poll
+// is not seen. The latency is logged every `report_every` samples (see SDL::debug).
+class Input {
+    public:
+	// State: What the controls ask for, after the inputs applied so far.
+	struct State {
+		bool left = false;
+		bool right = false;
+		// set by mouse motions, cleared when a direction key is pressed
+		std::optional<int> mouse_x{};
+	};
+
+	static constexpr Uint64 report_every = 600;
+	static constexpr std::size_t capacity = 1024;
+	// slots only key events may take, so a burst of motions never drops a key release
+	static constexpr std::size_t key_room = 64;
+
+    private:
+	struct Event {
+		Uint64 time;
+		enum Kind { keyboard, motion } kind;
+		SDL_Keycode key;
+		bool pressed;
+		int x;
+	};
+
+	Spsc_queue<Event, capacity> queue{};
+	std::optional<Event> next{}; // popped, but after the tick being applied
+	State state{};
+
+	Uint64 frequency = SDL::getPerformanceFrequency();
+	Uint64 unpresented = 0; // time of the first input applied since the last present, 0 if none
+	Uint64 samples = 0;
+	Uint64 total = 0;
+	Uint64 worst = 0;
+
+	static int watch(void *userdata, SDL_Event *event)
+	{
+		auto *input = static_cast<Input *>(userdata);
+		Uint64 time = Frame_pacer::clock();
+		switch (event->type) {
+		case SDL_KEYDOWN:
+		case SDL_KEYUP:
+			if (event->key.repeat == 0)
+				input->queue.push({ time, Event::keyboard, event->key.keysym.sym,
+						     event->type == SDL_KEYDOWN, 0 });
+			break;
+		case SDL_MOUSEMOTION:
+			// only the latest position matters, older ones can go when the queue fills up
+			if (input->queue.size() < capacity - key_room)
+				input->queue.push({ time, Event::motion, 0, false, event->motion.x });
+			break;
+		}
+		return 1;
+	}
+
+	void apply(const Event &event)
+	{
+		if (event.kind == Event::motion) {
+			state.mouse_x = event.x;
+			return;
+		}
+		if (event.key == SDLK_LEFT)
+			state.left = event.pressed;
+		else if (event.key == SDLK_RIGHT)
+			state.right = event.pressed;
+		else
+			return;
+		if (event.pressed)
+			state.mouse_x = std::nullopt;
+	}
+
+	double ms(Uint64 counts) const
+	{
+		return static_cast<double>(counts) * 1000 / static_cast<double>(frequency);
+	}
+
+    public:
+	Input()
+	{
+		SDL::addEventWatch(&Input::watch, this);
+	}
+
+	Input(const Input &) = delete;
+	Input &operator=(const Input &) = delete;
+
+	~Input()
+	{
+		SDL::delEventWatch(&Input::watch, this);
+	}
+
+	// Applies every input that happened up to `time` and returns the resulting state.
+	const State &advance(Uint64 time)
+	{
+		for (;;) {
+			if (!next)
+				next = queue.pop();
+			if (!next || next->time > time)
+				break;
+			apply(*next);
+			if (unpresented == 0)
+				unpresented = std::max<Uint64>(next->time, 1);
+			next.reset();
+		}
+		return state;
+	}
+
+	// Applies every pending input without measuring it, e.g. after an overlay. Keys are
+	// then read from the keyboard state, in case a release was lost while nothing drained
+	// the queue; scripted events under the virtual clock do not reach that state.
+	void skip()
+	{
+		while (auto event = next ? next : queue.pop()) {
+			apply(*event);
+			next.reset();
+		}
+		unpresented = 0;
+		if (!Virtual_clock::enabled) {
+			state.left = SDL::isPressed(SDL_SCANCODE_LEFT);
+			state.right = SDL::isPressed(SDL_SCANCODE_RIGHT);
+		}
+	}
+
+	// To be called once the frame is presented, at `time`, to measure the poll to present latency.
+	void presented(Uint64 time)
+	{
+		if (unpresented == 0)
+			return;
+		Uint64 latency = time > unpresented ? time - unpresented : 0;
+		unpresented = 0;
+		samples++;
+		total += latency;
+		worst = std::max(worst, latency);
+		if (samples % report_every == 0)
+			SDL::debug("Input poll to present latency: " + std::to_string(get_average_ms()) +
+				   " ms average, " + std::to_string(get_worst_ms()) + " ms worst over " +
+				   std::to_string(samples) + " inputs");
+	}
+
+	const State &get_state() const
+	{
+		return state;
+	}
+
+	Uint64 get_samples() const
+	{
+		return samples;
+	}
+
+	double get_average_ms() const
+	{
+		return samples == 0 ? 0 : ms(total) / static_cast<double>(samples);
+	}
+
+	double get_worst_ms() const
+	{
+		return ms(worst);
+	}
+};
@@ -0,0 +1,384 @@
+#pragma once
+
+#include "logic.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Udp_socket: Non-blocking UDP socket exchanging datagrams with a single peer. Without
+// a peer given up front, the peer is whoever sends the first datagram.
+class Udp_socket {
+    private:
+	int fd = -1;
+	sockaddr_storage peer{};
+	socklen_t peer_len = 0;
+
+	[[noreturn]] static void fail(const std::string &what)
+	{
+		throw std::runtime_error(what + ": " + std::strerror(errno));
+	}
+
+    public:
+	// Listens on port, any free port when 0.
+	Udp_socket(std::uint16_t port = 0)
+	{
+		fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+		if (fd < 0)
+			fail("socket");
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons(port);
+		if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+		    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+			::close(fd);
+			fail("bind");
+		}
+	}
+
+	Udp_socket(Udp_socket &&other) noexcept
+		: fd(std::exchange(other.fd, -1))
+		, peer(other.peer)
+		, peer_len(other.peer_len)
+	{
+	}
+
+	Udp_socket(const Udp_socket &) = delete;
+	Udp_socket &operator=(const Udp_socket &) = delete;
+
+	~Udp_socket()
+	{
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	// Sends every datagram to host:port from now on.
+	void connect(const std::string &host, std::uint16_t port)
+	{
+		addrinfo hints{};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_DGRAM;
+		addrinfo *res = nullptr;
+		if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0 || !res)
+			throw std::runtime_error("Unknown host " + host);
+		std::memcpy(&peer, res->ai_addr, res->ai_addrlen);
+		peer_len = res->ai_addrlen;
+		::freeaddrinfo(res);
+	}
+
+	std::uint16_t local_port() const
+	{
+		sockaddr_in addr{};
+		socklen_t len = sizeof(addr);
+		if (::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) < 0)
+			fail("getsockname");
+		return ntohs(addr.sin_port);
+	}
+
+	bool has_peer() const
+	{
+		return peer_len != 0;
+	}
+
+	// Dropped silently until there is a peer or when the socket buffer is full, like any lost datagram.
+	void send(std::span<const std::byte> data)
+	{
+		if (has_peer())
+			::sendto(fd, data.data(), data.size(), 0, reinterpret_cast<const sockaddr *>(&peer), peer_len);
+	}
+
+	// Size of the next datagram from the peer, written to buffer, or nullopt when none is pending.
+	std::optional<std::size_t> receive(std::span<std::byte> buffer)
+	{
+		for (;;) {
+			sockaddr_storage from{};
+			socklen_t from_len = sizeof(from);
+			ssize_t n = ::recvfrom(fd, buffer.data(), buffer.size(), 0, reinterpret_cast<sockaddr *>(&from),
+					       &from_len);
+			if (n < 0)
+				return std::nullopt;
+			if (!has_peer()) {
+				peer = from;
+				peer_len = from_len;
+			} else if (from_len != peer_len || std::memcmp(&from, &peer, from_len) != 0) {
+				continue; // not from the peer
+			}
+			return static_cast<std::size_t>(n);
+		}
+	}
+};
+
+// Tick_input: What a player does during one lockstep tick.
+struct Tick_input {
+	Paddle::dir dir = Paddle::none;
+	bool launch = false;
+};
+
+// Lockstep: Two players running the same Logic, exchanging only their inputs.
+//
+// Both peers start from the same level and step it with the same inputs, which is
+// enough since Logic::step is deterministic. The input of a player is scheduled
+// `delay` ticks ahead, so it usually reaches the peer before that tick is due; a
+// tick whose remote input has not arrived yet stalls instead of being guessed.
+// Each packet repeats the last few scheduled inputs, one byte each, so a lost packet
+// is covered by the next one, and carries the hash of the state every hash_every
+// ticks: a mismatch means the peers have diverged. A peer that leaves says so with a
+// single byte packet; one that goes silent for `timeout` is considered gone as well.
+// A peer showing a menu keeps calling poll(), so it is not mistaken for a gone one.
+class Lockstep {
+    public:
+	static constexpr int max_delay = 16;
+	static constexpr int redundancy = 8;
+	static constexpr int hash_every = 30;
+	static constexpr std::chrono::milliseconds default_timeout{ 5000 };
+
+    private:
+	// inputs kept around, enough for the peer to be `delay` ticks ahead of our own schedule
+	static constexpr std::size_t window = 64;
+	static constexpr std::size_t hashes = 8;
+	static constexpr std::size_t max_packet = 4 + 1 + redundancy + 4 + 8;
+	static constexpr std::byte bye{ 0xff };
+
+	Udp_socket socket;
+	std::size_t player;
+	int delay;
+	float dt;
+	std::chrono::milliseconds timeout;
+
+	int tick = 0;	   // next tick to simulate
+	int scheduled = 0; // local inputs are known for ticks before this one
+
+	// tick each slot holds the input of, -1 when empty
+	std::array<std::pair<int, Tick_input>, window> local{};
+	std::array<std::pair<int, Tick_input>, window> remote{};
+	std::array<std::pair<int, std::uint64_t>, hashes> local_hashes{};
+	std::array<std::pair<int, std::uint64_t>, hashes> remote_hashes{};
+	std::optional<int> desync{};
+
+	std::optional<std::chrono::steady_clock::time_point> last_heard{}; // unset until the peer is heard from
+	bool peer_left = false;
+
+	std::uint64_t sent = 0;
+
+	static std::byte encode(Tick_input input)
+	{
+		return static_cast<std::byte>(static_cast<unsigned>(input.dir) | (input.launch ? 4u : 0u));
+	}
+
+	static Tick_input decode(std::byte byte)
+	{
+		auto bits = std::to_integer<unsigned>(byte);
+		return { static_cast<Paddle::dir>(std::min(bits & 3u, 2u)), (bits & 4u) != 0 };
+	}
+
+	template <typename T> static void put(std::byte *&out, T value)
+	{
+		for (std::size_t i = 0; i < sizeof(T); i++)
+			*out++ = static_cast<std::byte>((value >> (8 * i)) & 0xff);
+	}
+
+	template <typename T> static T get(const std::byte *&in)
+	{
+		T value = 0;
+		for (std::size_t i = 0; i < sizeof(T); i++)
+			value |= static_cast<T>(std::to_integer<T>(*in++) << (8 * i));
+		return value;
+	}
+
+	// ticks before the delay have no input, identical on both sides
+	std::optional<Tick_input> input_at(const std::array<std::pair<int, Tick_input>, window> &inputs, int t) const
+	{
+		if (t < delay)
+			return Tick_input{};
+		const auto &slot = inputs[static_cast<std::size_t>(t) % window];
+		if (slot.first != t)
+			return std::nullopt;
+		return slot.second;
+	}
+
+	void check(int t)
+	{
+		const auto &mine = local_hashes[static_cast<std::size_t>(t / hash_every) % hashes];
+		const auto &theirs = remote_hashes[static_cast<std::size_t>(t / hash_every) % hashes];
+		if (!desync && mine.first == t && theirs.first == t && mine.second != theirs.second)
+			desync = t;
+	}
+
+	// Layout, little endian: last scheduled tick (u32), input count (u8), the inputs
+	// oldest first, tick of the latest hash (u32), the hash (u64).
+	void send()
+	{
+		std::array<std::byte, max_packet> packet;
+		std::byte *out = packet.data();
+		int count = std::min(scheduled, redundancy);
+		put(out, static_cast<std::uint32_t>(scheduled - 1));
+		put(out, static_cast<std::uint8_t>(count));
+		for (int t = scheduled - count; t < scheduled; t++)
+			*out++ = encode(local[static_cast<std::size_t>(t) % window].second);
+
+		auto latest = std::max_element(local_hashes.begin(), local_hashes.end());
+		put(out, static_cast<std::uint32_t>(latest->first));
+		put(out, latest->second);
+
+		auto size = static_cast<std::size_t>(out - packet.data());
+		socket.send(std::span(packet).first(size));
+		sent += size;
+	}
+
+	void receive(std::span<const std::byte> packet)
+	{
+		if (packet.size() == 1 && packet[0] == bye)
+			peer_left = true;
+		if (packet.size() < 5)
+			return;
+		const std::byte *in = packet.data();
+		auto last = static_cast<int>(get<std::uint32_t>(in));
+		int count = get<std::uint8_t>(in);
+		if (packet.size() != static_cast<std::size_t>(5 + count + 12))
+			return;
+		for (int t = last - count + 1; t <= last; t++) {
+			auto input = decode(*in++);
+			// older ticks are already simulated and their slots may be reused
+			if (t >= tick)
+				remote[static_cast<std::size_t>(t) % window] = { t, input };
+		}
+
+		auto hash_tick = static_cast<int>(get<std::uint32_t>(in));
+		auto hash = get<std::uint64_t>(in);
+		if (hash_tick > 0 && hash_tick % hash_every == 0) {
+			remote_hashes[static_cast<std::size_t>(hash_tick / hash_every) % hashes] = { hash_tick, hash };
+			check(hash_tick);
+		}
+	}
+
+    public:
+	// player is this peer's paddle in the Logic, which must already have a paddle per player.
+	Lockstep(Udp_socket socket, std::size_t player, int delay = 3, float dt = 1.f / 60,
+		 std::chrono::milliseconds timeout = default_timeout)
+		: socket(std::move(socket))
+		, player(player)
+		, delay(std::clamp(delay, 0, max_delay))
+		, dt(dt)
+		, timeout(timeout)
+	{
+		local.fill({ -1, {} });
+		remote.fill({ -1, {} });
+		local_hashes.fill({ 0, 0 });
+		remote_hashes.fill({ 0, 0 });
+		scheduled = this->delay;
+	}
+
+	Lockstep(const Lockstep &) = delete;
+	Lockstep &operator=(const Lockstep &) = delete;
+
+	// Tells the peer this player left, a few times since any of them may be lost.
+	~Lockstep()
+	{
+		std::array<std::byte, 1> packet = { bye };
+		for (int i = 0; i < 3; i++)
+			socket.send(packet);
+	}
+
+	// Whether the local input of the next scheduled tick is wanted.
+	bool needs_input() const
+	{
+		return scheduled < tick + delay + 1;
+	}
+
+	// Schedules the local input `delay` ticks after the next tick to simulate.
+	void input(Tick_input in)
+	{
+		if (!needs_input())
+			return;
+		local[static_cast<std::size_t>(scheduled) % window] = { scheduled, in };
+		scheduled++;
+	}
+
+	// Simulates the next tick when the inputs of both players are known, otherwise
+	// returns false and the caller tries again later. Sends the local inputs either way.
+	bool step(Logic &logic)
+	{
+		poll();
+
+		auto mine = input_at(local, tick);
+		auto theirs = input_at(remote, tick);
+		if (!mine || !theirs)
+			return false;
+
+		// always in player order, so that both peers apply them the same way
+		std::size_t peer = 1 - player;
+		std::array<std::pair<std::size_t, Tick_input>, 2> inputs = { { { player, *mine }, { peer, *theirs } } };
+		if (peer < player)
+			std::swap(inputs[0], inputs[1]);
+		for (auto &[p, in] : inputs) {
+			logic.set_paddle_dir(in.dir, p);
+			if (in.launch)
+				logic.launch_ball(p);
+		}
+		logic.step(dt);
+		tick++;
+
+		if (tick % hash_every == 0) {
+			local_hashes[static_cast<std::size_t>(tick / hash_every) % hashes] = { tick, logic.hash() };
+			check(tick);
+		}
+		return true;
+	}
+
+	// Sends the local inputs and takes those of the peer without simulating, to keep the
+	// session alive while the game is not stepped, e.g. in the pause menu.
+	void poll()
+	{
+		send();
+
+		std::array<std::byte, max_packet> packet;
+		while (auto size = socket.receive(packet)) {
+			last_heard = std::chrono::steady_clock::now();
+			receive(std::span(packet).first(std::min(*size, packet.size())));
+		}
+	}
+
+	std::size_t get_player() const
+	{
+		return player;
+	}
+
+	int get_tick() const
+	{
+		return tick;
+	}
+
+	// Whether the peer left or has not been heard from for `timeout`, as seen by the last
+	// step() or poll(). Before the peer is first heard from, it may still be joining.
+	bool peer_lost() const
+	{
+		return peer_left || (last_heard && std::chrono::steady_clock::now() - *last_heard > timeout);
+	}
+
+	// First tick at which the states were seen to differ.
+	std::optional<int> get_desync() const
+	{
+		return desync;
+	}
+
+	std::uint64_t get_sent_bytes() const
+	{
+		return sent;
+	}
+};
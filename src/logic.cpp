@@ -1,16 +1,22 @@
 #include "logic.h"
 
 #include "exception.h"
+#include "spectate.h"
+#include "textio.h"
 #include "vec2.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <istream>
 #include <limits>
 #include <optional>
 #include <ostream>
 #include <span>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -172,6 +178,7 @@ template <> void Logic::collide(Ball &ball, Brick &brick)
 		return;
 
 	brick.dura--;
+	impacts.push_back({ brick.dura == 0 ? Impact::brick_destroyed : Impact::brick_hit, closest.x, closest.y });
 	if (brick.dura == 0) {
 		brick_count--;
 		score += brick_points;
@@ -248,6 +255,7 @@ template <> void Logic::collide(Ball &ball, Paddle &paddle)
 	ball.vy = v_t.y + new_v_n.y;
 
 	bounce_count++;
+	impacts.push_back({ Impact::paddle, ball.x - vec_unit.x * ball.r, ball.y - vec_unit.y * ball.r });
 }
 
 template <> void Logic::collide(Ball &ball, Powerup &powerup)
@@ -287,6 +295,7 @@ template <> void Logic::collide(Ball &ball, Powerup &powerup)
 void Logic::step(float dt)
 {
 	tick++;
+	impacts.clear();
 
 	for (auto &powerup : powerups)
 		move(powerup, dt);
@@ -294,7 +303,8 @@ void Logic::step(float dt)
 	for (auto &ball : balls)
 		move(ball, dt);
 
-	move(paddle, dt);
+	for (auto &paddle : paddles)
+		move(paddle, dt);
 
 	for (size_t i = 0; i < balls.size(); i++) {
 		for (auto &brick : bricks)
@@ -306,7 +316,8 @@ void Logic::step(float dt)
 		for (size_t j = i + 1; j < balls.size(); j++)
 			collide(balls[i], balls[j]);
 
-		collide(balls[i], paddle);
+		for (auto &paddle : paddles)
+			collide(balls[i], paddle);
 	}
 
 	if (brick_count <= 0) {
@@ -316,14 +327,63 @@ void Logic::step(float dt)
 	}
 }
 
-void Logic::launch_ball()
+void Logic::launch_ball(std::size_t player)
 {
 	if (lives <= 0)
 		return;
+	const Paddle &paddle = paddles.at(player);
 	add_ball(paddle.x, paddle.y - paddle.h / 2, 0, -1);
 	lives--;
 }
 
+std::size_t Logic::add_player()
+{
+	paddles.emplace_back(w / 2, h - Paddle::h);
+	for (std::size_t i = 0; i < paddles.size(); i++)
+		paddles[i].x = w * static_cast<float>(i + 1) / static_cast<float>(paddles.size() + 1);
+	return paddles.size() - 1;
+}
+
+// FNV-1a step over the exact bits of a value
+template <typename T> static void hash_add(std::uint64_t &hash, T value)
+{
+	unsigned char bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	for (unsigned char byte : bytes) {
+		hash ^= byte;
+		hash *= 0x100000001b3;
+	}
+}
+
+std::uint64_t Logic::hash() const
+{
+	std::uint64_t hash = 0xcbf29ce484222325;
+	hash_add(hash, tick);
+	hash_add(hash, static_cast<int>(state));
+	hash_add(hash, score);
+	hash_add(hash, lives);
+	hash_add(hash, bonus_speed);
+	hash_add(hash, bounce_count);
+	for (const auto &paddle : paddles) {
+		hash_add(hash, paddle.x);
+		hash_add(hash, paddle.y);
+	}
+	for (const auto &ball : balls) {
+		hash_add(hash, ball.x);
+		hash_add(hash, ball.y);
+		hash_add(hash, ball.vx);
+		hash_add(hash, ball.vy);
+		hash_add(hash, ball.alive);
+	}
+	for (const auto &brick : bricks)
+		hash_add(hash, brick.dura);
+	for (const auto &powerup : powerups) {
+		hash_add(hash, powerup.y);
+		hash_add(hash, powerup.alive);
+	}
+	return hash;
+}
+
 bool point_in_polygon(vec2f point, std::span<std::pair<float, float> > vertices)
 {
 	bool inside = false;
@@ -405,6 +465,8 @@ void Logic::replace_brick_safe(std::size_t index, float x, float y)
 
 void Logic::remove_brick(std::size_t index)
 {
+	if (bricks.at(index).dura > 0)
+		brick_count--;
 	bricks.erase(bricks.begin() + static_cast<long>(index));
 }
 
@@ -447,132 +509,155 @@ void Logic::init()
 	add_brick(w / 3, h / 2, Brick::rect, 1, Powerup::extra_ball);
 }
 
-void Logic::save(std::ostream &output)
+void Logic::save(std::ostream &output) const
 {
-	output << w << "," << h << std::endl;
-	output << tick << std::endl;
-	output << score << "," << combo << std::endl;
-	output << bonus_speed << "," << bounce_count << std::endl;
-	output << lives << "," << paddle.x << "," << paddle.y << std::endl;
-	output << ball_count << std::endl;
+	// balls and bricks take at most a few dozen characters per record
+	Text_writer writer;
+	writer.reserve(128 + 48 * balls.size() + 40 * bricks.size());
+
+	writer.record(w, h);
+	writer.record(tick);
+	writer.record(score, combo);
+	writer.record(bonus_speed, bounce_count);
+	writer.record(lives, paddles[0].x, paddles[0].y);
+	writer.record(ball_count);
 	for (auto &ball : balls) {
 		if (!ball.alive)
 			continue;
-		output << ball.x << "," << ball.y << "," << ball.vx << "," << ball.vy << std::endl;
+		writer.record(ball.x, ball.y, ball.vx, ball.vy);
 	}
-	output << brick_count << std::endl;
+	writer.record(brick_count);
 	for (auto &brick : bricks) {
 		if (brick.dura == 0)
 			continue;
-		auto powerup = brick.powerup ? brick.powerup.value() : -1;
+		int powerup = brick.powerup ? brick.powerup.value() : -1;
 
-		output << brick.x << "," << brick.y << "," << brick.dura << "," << brick.shape << "," << powerup
-		       << std::endl;
+		writer.record(brick.x, brick.y, brick.dura, static_cast<int>(brick.shape), powerup);
 	}
+
+	writer.flush(output);
 }
 
-void health_check(std::istream &cin)
+void Logic::mirror(const Stream_state &mirrored)
 {
-	if (cin.eof() || cin.bad() || cin.fail())
-		throw Bad_format();
+	auto x = [&](Stream_state::Point p) { return static_cast<float>(p.x) * mirrored.scale; };
+	auto y = [&](Stream_state::Point p) { return static_cast<float>(p.y) * mirrored.scale; };
+	auto shape = [](const Stream_state::Brick_state &b) {
+		return b.shape == Brick::hex ? Brick::hex : Brick::rect;
+	};
+
+	w = mirrored.w;
+	h = mirrored.h;
+	tick = static_cast<int>(mirrored.tick);
+	score = static_cast<int>(mirrored.score);
+	lives = mirrored.lives;
+	state = static_cast<GameState>(std::min<unsigned>(mirrored.state, LOST));
+
+	paddles.clear();
+	for (auto p : mirrored.paddles)
+		paddles.emplace_back(x(p), y(p));
+
+	balls.clear();
+	for (auto p : mirrored.balls) {
+		Ball &ball = balls.emplace_back(x(p), y(p), 0, 0);
+		ball.alive = p != Stream_state::dead;
+	}
+
+	bool same_layout = bricks.size() == mirrored.bricks.size();
+	for (std::size_t i = 0; same_layout && i < bricks.size(); i++) {
+		const auto &b = mirrored.bricks[i];
+		same_layout = bricks[i].x == x(b.pos) && bricks[i].y == y(b.pos) && bricks[i].shape == shape(b);
+	}
+	if (same_layout) {
+		for (std::size_t i = 0; i < bricks.size(); i++) {
+			if (bricks[i].dura != mirrored.bricks[i].dura) {
+				bricks[i].dura = mirrored.bricks[i].dura;
+				bricks[i].last_hit = tick;
+			}
+		}
+	} else {
+		bricks.clear();
+		bricks.reserve(mirrored.bricks.size());
+		for (const auto &b : mirrored.bricks)
+			bricks.emplace_back(x(b.pos), y(b.pos), shape(b), b.dura);
+	}
+
+	powerups.clear();
+	for (const auto &p : mirrored.powerups) {
+		auto type = static_cast<Powerup::type>(std::min<unsigned>(p.type, Powerup::strong_ball));
+		Powerup &powerup = powerups.emplace_back(x(p.pos), y(p.pos), type);
+		powerup.alive = p.alive;
+	}
 }
 
-Logic Logic::load(std::istream &save)
+Logic Logic::parse(std::string_view save, std::atomic<float> *progress)
 {
-	constexpr auto max_size = std::numeric_limits<std::streamsize>::max();
+	constexpr size_t progress_step = 1024;
 
-	float w, h;
-	save.clear();
+	Text_reader reader(save);
 
-	save >> w;
-	save.ignore(max_size, ',');
-	save >> h;
-	save.ignore(max_size, '\n');
-	health_check(save);
+	float w = reader.read<float>();
+	reader.skip(',');
+	float h = reader.read<float>();
+	reader.skip('\n');
 
 	Logic logic{ w, h };
 
-	health_check(save);
-	save >> logic.tick;
-	health_check(save);
-	save.ignore(max_size, '\n');
-
-	save >> logic.score;
-	health_check(save);
-	save.ignore(max_size, ',');
-	save >> logic.combo;
-	health_check(save);
-	save.ignore(max_size, '\n');
-
-	save >> logic.bonus_speed;
-	health_check(save);
-	save.ignore(max_size, ',');
-	save >> logic.bounce_count;
-	health_check(save);
-	save.ignore(max_size, '\n');
-
-	save >> logic.lives;
-	health_check(save);
-	save.ignore(max_size, ',');
-	save >> logic.paddle.x;
-	health_check(save);
-	save.ignore(max_size, ',');
-	save >> logic.paddle.y;
-	health_check(save);
-	save.ignore(max_size, '\n');
-
-	size_t ball_count = 0;
-	save >> ball_count;
-	health_check(save);
-	save.ignore(max_size, '\n');
+	reader.read(logic.tick);
+	reader.skip('\n');
 
+	reader.read(logic.score);
+	reader.skip(',');
+	reader.read(logic.combo);
+	reader.skip('\n');
+
+	reader.read(logic.bonus_speed);
+	reader.skip(',');
+	reader.read(logic.bounce_count);
+	reader.skip('\n');
+
+	reader.read(logic.lives);
+	reader.skip(',');
+	reader.read(logic.paddles[0].x);
+	reader.skip(',');
+	reader.read(logic.paddles[0].y);
+	reader.skip('\n');
+
+	size_t ball_count = reader.read<size_t>();
+	reader.skip('\n');
+
+	logic.balls.reserve(std::min(ball_count, save.size()));
 	for (size_t i = 0; i < ball_count; i++) {
-		float x, y, vx, vy;
-
-		health_check(save);
-		save >> x;
-		health_check(save);
-		save.ignore(max_size, ',');
-		save >> y;
-		health_check(save);
-		save.ignore(max_size, ',');
-		save >> vx;
-		health_check(save);
-		save.ignore(max_size, ',');
-		save >> vy;
-		health_check(save);
-		save.ignore(max_size, '\n');
+		float x = reader.read<float>();
+		reader.skip(',');
+		float y = reader.read<float>();
+		reader.skip(',');
+		float vx = reader.read<float>();
+		reader.skip(',');
+		float vy = reader.read<float>();
+		reader.skip('\n');
 
 		logic.add_ball(x, y, vx, vy);
+
+		if (progress && i % progress_step == 0)
+			progress->store(reader.progress(), std::memory_order_relaxed);
 	}
 
-	size_t brick_count = 0;
-	save >> brick_count;
-	health_check(save);
-	save.ignore(max_size, '\n');
+	size_t brick_count = reader.read<size_t>();
+	reader.skip('\n');
 
+	logic.bricks.reserve(std::min(brick_count, save.size()));
 	for (size_t i = 0; i < brick_count; i++) {
-		float x, y;
-		uint durability;
-		int shape;
-		int powerup;
-
-		health_check(save);
-		save >> x;
-		health_check(save);
-		save.ignore(max_size, ',');
-		save >> y;
-		health_check(save);
-		save.ignore(max_size, ',');
-		save >> durability;
-		health_check(save);
-		save.ignore(max_size, ',');
-		save >> shape;
-		health_check(save);
-		save.ignore(max_size, ',');
-		save >> powerup;
-		save.ignore(max_size, '\n');
-		health_check(save);
+		float x = reader.read<float>();
+		reader.skip(',');
+		float y = reader.read<float>();
+		reader.skip(',');
+		uint durability = reader.read<uint>();
+		reader.skip(',');
+		int shape = reader.read<int>();
+		reader.skip(',');
+		int powerup = reader.read<int>();
+		reader.skip('\n');
 
 		std::optional<Powerup::type> p = powerup == -1 ? std::nullopt :
 								 std::optional<Powerup::type>(Powerup::type(powerup));
@@ -585,7 +670,13 @@ Logic Logic::load(std::istream &save)
 			throw Bad_format();
 		}
 		logic.add_brick(x, y, Brick::Shape(shape), durability, p);
+
+		if (progress && i % progress_step == 0)
+			progress->store(reader.progress(), std::memory_order_relaxed);
 	}
 
+	if (progress)
+		progress->store(1, std::memory_order_relaxed);
+
 	return logic;
 }
@@ -1,17 +1,24 @@
 #pragma once
 
 #include "exception.h"
+#include "textio.h"
 
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <istream>
 #include <optional>
 #include <ostream>
+#include <span>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
+struct Stream_state;
+
 class Paddle {
     public:
 	enum dir {
@@ -232,6 +239,12 @@ class Logic {
 		LOST,
 	};
 
+	// Impact: A collision of the last step, reported for effects only.
+	struct Impact {
+		enum Kind { brick_hit, brick_destroyed, paddle } kind;
+		float x, y;
+	};
+
 	Logic(float width, float height, bool default_stage = false)
 		: w(width)
 		, h(height)
@@ -240,23 +253,33 @@ class Logic {
 			init();
 	}
 
-	static Logic load(const std::string &save_file)
+	// progress, when given, is updated from 0 to 1 while parsing so that
+	// another thread can follow a load running in the background.
+	static Logic load(const std::string &save_file, std::atomic<float> *progress = nullptr)
+	{
+		return parse(read_file(save_file), progress);
+	}
+
+	static Logic load(std::istream &save)
 	{
-		std::ifstream save_import(save_file, std::ios::in);
-		if (!save_import.is_open())
-			throw Bad_format();
-		Logic l(load(save_import));
-		save_import.close();
-		return l;
+		return parse(read_stream(save));
 	}
 
-	static Logic load(std::istream &save);
+	static Logic parse(std::string_view save, std::atomic<float> *progress = nullptr);
 
 	void step(float dt);
 
-	void set_paddle_dir(Paddle::dir d)
+	void set_paddle_dir(Paddle::dir d, std::size_t player = 0)
+	{
+		paddles.at(player).direction = d;
+	}
+
+	// Adds a paddle for another player and spreads the paddles over the width.
+	std::size_t add_player();
+
+	std::size_t get_player_count() const
 	{
-		paddle.direction = d;
+		return paddles.size();
 	}
 
 	float get_width() const
@@ -306,14 +329,16 @@ class Logic {
 		for (auto &powerup : powerups) {
 			visitor(powerup);
 		}
-		visitor(paddle);
+		for (auto &paddle : paddles) {
+			visitor(paddle);
+		}
 	}
 
-	void launch_ball();
+	void launch_ball(std::size_t player = 0);
 
-	Paddle &get_paddle()
+	Paddle &get_paddle(std::size_t player = 0)
 	{
-		return paddle;
+		return paddles.at(player);
 	}
 
 	Brick &get_brick(std::size_t index)
@@ -321,6 +346,31 @@ class Logic {
 		return bricks.at(index);
 	}
 
+	std::span<const Brick> get_bricks() const
+	{
+		return bricks;
+	}
+
+	std::span<const Ball> get_balls() const
+	{
+		return balls;
+	}
+
+	std::span<const Powerup> get_powerups() const
+	{
+		return powerups;
+	}
+
+	std::span<const Paddle> get_paddles() const
+	{
+		return paddles;
+	}
+
+	std::span<const Impact> get_impacts() const
+	{
+		return impacts;
+	}
+
 	std::optional<std::pair<std::size_t, Brick &> > get_brick(float x, float y);
 
 	std::optional<std::size_t> add_brick_safe(float x, float y, uint durability);
@@ -334,7 +384,26 @@ class Logic {
 		return state;
 	}
 
-	void save(std::ostream &output);
+	// Hash of everything the simulation depends on, equal on two instances only when they are in the same
+	// state. step() is deterministic: the same state and inputs give the same state on every run of a build.
+	std::uint64_t hash() const;
+
+	void save(std::ostream &output) const;
+
+	// Throws Save_error when the file cannot be created or written completely.
+	void save(const std::string &save_file) const
+	{
+		std::ofstream save_export(save_file, std::ios::out);
+		if (!save_export.is_open())
+			throw Save_error();
+		save(save_export);
+		if (!save_export.flush())
+			throw Save_error();
+	}
+
+	// Replaces the state with one streamed by a host (see Spectator_view), to be shown
+	// rather than simulated. Bricks whose durability dropped are marked as just hit.
+	void mirror(const Stream_state &mirrored);
 
     private:
 	float w, h;
@@ -344,8 +413,10 @@ class Logic {
 	std::vector<Ball> balls{};
 	std::vector<Brick> bricks{};
 	std::vector<Powerup> powerups{};
+	std::vector<Impact> impacts{};
 
-	Paddle paddle{ w / 2, h - Paddle::h };
+	// the first paddle is the one saved
+	std::vector<Paddle> paddles{ Paddle{ w / 2, h - Paddle::h } };
 
 	int brick_count = 0;
 	int ball_count = 0;
@@ -374,4 +445,5 @@ class Logic {
 	template <typename T> void collide(Ball &ball, T &object);
 
 	void init();
+
 };
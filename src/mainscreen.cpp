@@ -1,8 +1,8 @@
 #include "mainscreen.h"
 
-#include "editor.h"
+#include "pacer.h"
 #include "sdl.h"
-#include "selection.h"
+#include "states.h"
 
 #include <memory>
 
@@ -14,7 +14,7 @@ std::shared_ptr<State> MainScreen::operator()()
 	float alpha = 0, beta = 0;
 
 	for (;;) {
-		auto event = SDL::waitEvent();
+		auto event = Frame_pacer::next_event();
 
 		switch (event.type) {
 		case SDL_QUIT:
@@ -29,13 +29,13 @@ std::shared_ptr<State> MainScreen::operator()()
 			break;
 		case SDL_MOUSEBUTTONDOWN:
 			if (play.is_over(x, y)) {
-				return std::make_shared<Selection>(window, renderer);
+				return states.selection;
 			}
 			if (exit.is_over(x, y)) {
 				throw Close();
 			}
 			if (editor.is_over(x, y)) {
-				return std::make_shared<Editor>(window, renderer);
+				return states.editor;
 			}
 			break;
 		case SDL_KEYDOWN:
@@ -51,11 +51,11 @@ std::shared_ptr<State> MainScreen::operator()()
 				switch (key_target) {
 				case 5:
 				case 0:
-					return std::make_shared<Selection>(window, renderer);
+					return states.selection;
 				case 1:
 					throw Close();
 				case 2:
-					return std::make_shared<Editor>(window, renderer);
+					return states.editor;
 				}
 			}
 			break;
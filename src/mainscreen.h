@@ -1,9 +1,12 @@
 #pragma once
 
+#include "cache.h"
 #include "fsm.h"
 #include "sdl.h"
 #include "widget.h"
 
+#include <memory>
+
 // Background: Class to handle one panel of the parallax effect.
 class Background {
     public:
@@ -13,7 +16,7 @@ class Background {
 	float distance;
 
 	Background(SDL::Renderer &renderer, const std::string &filename, unsigned int p)
-		: texture(renderer, filename)
+		: texture(Asset_cache::texture(renderer, filename))
 		, src(texture.getRect())
 		, dst(0, 0, static_cast<float>(src.w), static_cast<float>(src.h))
 		, distance(p)
@@ -28,11 +31,14 @@ class Background {
 	}
 };
 
-// MainScreen: Class to handle the main menu screen.
+class States;
+
+// MainScreen: Class to handle the main menu screen. Built once, see States.
 class MainScreen : public State {
     private:
 	SDL::Window window;
 	SDL::Renderer renderer;
+	States &states;
 	Label title, play, exit, editor;
 	Background stars, dust, nebulae, planets;
 
@@ -45,9 +51,10 @@ class MainScreen : public State {
 	unsigned int key_target = 5; //mod 3
 
     public:
-	MainScreen(const SDL::Window &w, const SDL::Renderer &r)
+	MainScreen(const SDL::Window &w, const SDL::Renderer &r, States &states)
 		: window(w)
 		, renderer(r)
+		, states(states)
 		, title("Meteor", title_font, fg, hl, renderer, 132, 35)
 		, play("Play", menu_font, fg, hl, renderer, 160, 95)
 		, exit("Exit", menu_font, fg, hl, renderer, 160, 145)
@@ -59,5 +66,10 @@ class MainScreen : public State {
 	{
 	}
 
+	void on_enter() override
+	{
+		key_target = 5;
+	}
+
 	std::shared_ptr<State> operator()() override;
 };
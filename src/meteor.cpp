@@ -1,15 +1,146 @@
+#include "atlas.h"
+#include "cache.h"
 #include "exception.h"
-#include "mainscreen.h"
+#include "game.h"
+#include "lockstep.h"
+#include "recorder.h"
 #include "sdl.h"
+#include "spectate.h"
+#include "states.h"
 
-int main(void)
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// Parses the whole of text as a number for option opt.
+template <typename T> static T parse(const std::string &opt, const std::string &text)
+{
+	T value{};
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+	if (error != std::errc() || end != text.data() + text.size())
+		throw std::invalid_argument("Invalid value " + text + " for " + opt);
+	return value;
+}
+
+static std::uint16_t parse_port(const std::string &opt, const std::string &text)
+{
+	auto port = parse<unsigned long>(opt, text);
+	if (port == 0 || port > 65535)
+		throw std::invalid_argument("Invalid port " + text + " for " + opt + ", expected 1 to 65535");
+	return static_cast<std::uint16_t>(port);
+}
+
+static std::pair<std::string, std::uint16_t> parse_address(const std::string &opt, const std::string &address)
+{
+	auto colon = address.rfind(':');
+	if (colon == std::string::npos)
+		throw std::invalid_argument(opt + " expects <host>:<port>");
+	return { address.substr(0, colon), parse_port(opt, address.substr(colon + 1)) };
+}
+
+// ./meteor [--record <directory> [--every <n>] [--raw]] [--host <port> | --join <host>:<port>] [--delay <ticks>]
+//          [--spectate <port> | --watch <host>:<port>]
+// --record writes every nth presented frame of the game to directory, as PNG or raw RGBA.
+// --host waits for a second player on a UDP port and --join connects to it, for a two player game in lockstep
+// with an input delay of --delay ticks (3 by default).
+// --spectate streams the games played to spectators on a TCP port, which --watch <host>:<port> shows.
+int main(int argc, char **argv)
 {
+	std::string record;
+	Uint64 every = 1;
+	auto format = Recorder::Format::png;
+	std::shared_ptr<Lockstep> session;
+	std::shared_ptr<Spectator_view> view;
+	std::shared_ptr<Spectator_server> server;
+
+	// bad options, busy ports and unknown hosts are reported before any window opens
+	try {
+		std::string host, join, spectate, watch;
+		int delay = 3;
+		for (int i = 1; i < argc; i++) {
+			std::string opt = argv[i];
+			if (opt == "--record" && i + 1 < argc)
+				record = argv[++i];
+			else if (opt == "--every" && i + 1 < argc)
+				every = parse<Uint64>(opt, argv[++i]);
+			else if (opt == "--raw")
+				format = Recorder::Format::raw;
+			else if (opt == "--host" && i + 1 < argc)
+				host = argv[++i];
+			else if (opt == "--join" && i + 1 < argc)
+				join = argv[++i];
+			else if (opt == "--delay" && i + 1 < argc)
+				delay = parse<int>(opt, argv[++i]);
+			else if (opt == "--spectate" && i + 1 < argc)
+				spectate = argv[++i];
+			else if (opt == "--watch" && i + 1 < argc)
+				watch = argv[++i];
+		}
+
+		if (!host.empty()) {
+			Udp_socket socket(parse_port("--host", host));
+			session = std::make_shared<Lockstep>(std::move(socket), 0, delay);
+		} else if (!join.empty()) {
+			auto [address, port] = parse_address("--join", join);
+			Udp_socket socket;
+			socket.connect(address, port);
+			session = std::make_shared<Lockstep>(std::move(socket), 1, delay);
+		}
+
+		if (!watch.empty()) {
+			auto [address, port] = parse_address("--watch", watch);
+			view = std::make_shared<Spectator_view>(address, port);
+		}
+		if (!spectate.empty())
+			server = std::make_shared<Spectator_server>(parse_port("--spectate", spectate));
+	} catch (std::exception const &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
 	SDL::Window window("SDL2 Example", 800, 600);
-	SDL::Renderer renderer(window, -1, SDL_RENDERER_ACCELERATED);
+	SDL::Renderer renderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 	renderer.setLogicalSize(400, 300);
 	renderer.setDrawBlendMode(SDL_BLENDMODE_BLEND);
 
-	FSM fsm(std::make_shared<MainScreen>(window, renderer));
+	// cached textures belong to the renderer and must be released before it
+	struct Cache_guard {
+		~Cache_guard()
+		{
+			Asset_cache::clear();
+		}
+	} cache_guard;
+
+	std::vector<std::string> assets = { "assets/stars.png", "assets/dust.png", "assets/nebulae.png",
+					    "assets/planets.png", "assets/ui.png", "assets/asteroid.png",
+					    "assets/asteroid_highlight.png" };
+	if (std::filesystem::exists(Atlas::image_file))
+		assets.push_back(Atlas::image_file);
+	Asset_cache::preload(renderer, assets);
+	Atlas::preload(renderer);
+
+	std::optional<Recorder> recorder;
+	if (!record.empty())
+		recorder.emplace(record, every, format);
+
+	States states(window, renderer, server);
+
+	std::shared_ptr<State> first;
+	if (session)
+		first = std::make_shared<Game>(window, renderer, states, std::move(session));
+	else if (view)
+		first = std::make_shared<Game>(window, renderer, states, view);
+	else
+		first = states.main_screen;
+	FSM fsm(first);
 
 	try {
 		fsm.run();
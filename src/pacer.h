@@ -0,0 +1,195 @@
+#pragma once
+
+#include "sdl.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <string>
+
+// Virtual_clock: Replaces wall time for headless runs.
+// While enabled, every frame presented or waited for advances the clock by exactly
+// one simulation tick, without sleeping, and calls on_frame, which scripted input
+// uses to push the events of that frame.
+struct Virtual_clock {
+	static inline bool enabled = false;
+	static inline Uint64 frame = 0;
+	static inline std::function<void(Uint64)> on_frame{};
+
+	static void advance()
+	{
+		frame++;
+		if (on_frame)
+			on_frame(frame);
+	}
+};
+
+// Frame_pacer: Paces the render loops and converts elapsed time into fixed simulation ticks.
+//
+// When the renderer presents with vsync, present() already blocks until the next
+// vertical blank and the pacer only measures. Otherwise it sleeps until the next
+// deadline, with SDL_Delay for the coarse part and a short spin on the
+// performance counter for the last millisecond, so frames do not drift like a
+// fixed delay after the work does.
+// A frame taking longer than 1.5 periods is reported as a missed deadline.
+class Frame_pacer {
+    public:
+	static constexpr int rate = 60;
+	// Simulation time advanced by one tick, in seconds.
+	static constexpr float tick = 1.f / rate;
+
+    private:
+	// ticks simulated at most per frame, so a long stall does not turn into a burst
+	static constexpr Uint64 max_ticks = 4;
+
+	Uint64 frequency;
+	Uint64 period;	    // counts per frame
+	Uint64 tick_period; // counts per simulation tick
+	bool vsync;
+
+	Uint64 deadline;
+	Uint64 last_frame;
+	Uint64 last_tick;
+	Uint64 accumulator = 0;
+	Uint64 pending = 0; // ticks returned by the last call to ticks()
+	unsigned missed = 0;
+
+	Uint64 now() const
+	{
+		return clock();
+	}
+
+	void sleep_until(Uint64 target) const
+	{
+		Uint64 now = SDL::getPerformanceCounter();
+		if (now >= target)
+			return;
+		Uint64 ms = (target - now) * 1000 / frequency;
+		if (ms > 1)
+			SDL::delay(static_cast<Uint32>(ms - 1));
+		while (SDL::getPerformanceCounter() < target)
+			;
+	}
+
+    public:
+	// Time in performance counter units, virtual time under the virtual clock.
+	static Uint64 clock()
+	{
+		if (Virtual_clock::enabled)
+			return Virtual_clock::frame * (SDL::getPerformanceFrequency() / rate);
+		return SDL::getPerformanceCounter();
+	}
+
+	Frame_pacer(const SDL::Window &window, const SDL::Renderer &renderer)
+		: frequency(SDL::getPerformanceFrequency())
+		, period()
+		, tick_period(frequency / rate)
+		, vsync(renderer.hasVsync())
+		, deadline()
+		, last_frame()
+		, last_tick()
+	{
+		int refresh = vsync ? window.getRefreshRate() : 0;
+		period = frequency / static_cast<Uint64>(refresh > 0 ? refresh : rate);
+		reset();
+	}
+
+	// Restarts the clock, e.g. after an overlay, so the time spent elsewhere is not simulated.
+	void reset()
+	{
+		last_frame = last_tick = now();
+		deadline = last_frame + period;
+		accumulator = 0;
+	}
+
+	// Number of simulation ticks to run for the time elapsed since the previous call.
+	int ticks()
+	{
+		Uint64 time = now();
+		accumulator += time - last_tick;
+		last_tick = time;
+
+		Uint64 n = accumulator / tick_period;
+		accumulator -= n * tick_period;
+		pending = std::min(n, max_ticks);
+		return static_cast<int>(pending);
+	}
+
+	// Time, on clock(), up to which tick k of those returned by ticks() takes input: the
+	// end of that tick, except for the last one, which takes everything until ticks() was
+	// called. Input is stamped when it is polled, after the end of most ticks, and would
+	// otherwise be held back to the next frame.
+	Uint64 tick_time(int k) const
+	{
+		if (static_cast<Uint64>(k) + 1 >= pending)
+			return last_tick;
+		return last_tick - accumulator - (pending - 1 - static_cast<Uint64>(k)) * tick_period;
+	}
+
+	// Presents the frame and waits for the next one.
+	void present(SDL::Renderer &renderer)
+	{
+		if (Virtual_clock::enabled) {
+			renderer.present();
+			Virtual_clock::advance();
+			return;
+		}
+
+		if (!vsync)
+			sleep_until(deadline);
+		renderer.present();
+
+		Uint64 now = SDL::getPerformanceCounter();
+		if ((now - last_frame) * 2 > period * 3) {
+			missed++;
+			Uint64 late = (now - last_frame - period) * 1000 / frequency;
+			SDL::debug("Missed frame deadline by " + std::to_string(late) + " ms");
+		}
+		last_frame = now;
+
+		// resynchronize instead of rushing the following frames after a miss
+		deadline += period;
+		if (deadline < now)
+			deadline = now + period;
+	}
+
+	// Returns the pending events until the next frame is due, then nullopt. Without
+	// vsync it blocks on the event queue in the meantime instead of sleeping, so
+	// animated loops stay idle yet react to input right away.
+	std::optional<SDL::Event> wait_event() const
+	{
+		if (Virtual_clock::enabled)
+			return SDL::pollEvent();
+
+		Uint64 now = SDL::getPerformanceCounter();
+		if (vsync || now >= deadline)
+			return SDL::pollEvent();
+		auto ms = static_cast<int>((deadline - now) * 1000 / frequency);
+		if (ms == 0)
+			return SDL::pollEvent();
+		return SDL::waitEventTimeout(ms);
+	}
+
+	// Blocks until the next event, for screens where nothing moves. Under the virtual
+	// clock, idle frames are skipped until the script provides one.
+	static SDL::Event next_event()
+	{
+		if (!Virtual_clock::enabled)
+			return SDL::waitEvent();
+		for (;;) {
+			if (auto event = SDL::pollEvent())
+				return *event;
+			Virtual_clock::advance();
+		}
+	}
+
+	unsigned get_missed() const
+	{
+		return missed;
+	}
+
+	bool has_vsync() const
+	{
+		return vsync;
+	}
+};
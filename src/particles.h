@@ -0,0 +1,199 @@
+#pragma once
+
+#include "sdl.h"
+
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+#include <span>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Particles: Short-lived effects (debris, sparks, trails) drawn from one texture.
+//
+// Particles live in a pool allocated once, as a structure of arrays so the update
+// runs four particles at a time with SSE (plain loop elsewhere). Live particles
+// are kept packed at the front: a dead one is replaced by the last one. When the
+// pool is full, new particles are dropped. Every live particle is drawn as a tinted
+// quad in a single geometry call, the index buffer being built once up front.
+class Particles {
+    public:
+	static constexpr std::size_t capacity = 1 << 15;
+
+	// Style: How the particles of an emission look and move. Ranges are uniform.
+	struct Style {
+		int sprite; // from add_sprite()
+		float speed_min, speed_max;
+		float life_min, life_max; // seconds
+		float size_min, size_max;
+		float gravity;
+		SDL::Color color;
+	};
+
+    private:
+	struct Sprite {
+		float u0, v0, u1, v1;
+	};
+
+	SDL::Texture texture;
+	std::vector<Sprite> sprites{};
+
+	// structure of arrays, [0, count) are alive
+	std::vector<float> x, y, vx, vy, gravity, life, inv_life, size;
+	std::vector<SDL::Color> color;
+	std::vector<int> sprite;
+	std::size_t count = 0;
+
+	std::vector<SDL::Vertex> vertices;
+	std::vector<int> indices;
+
+	Uint32 seed = 0x9e3779b9;
+
+	// xorshift, cheap and reproducible
+	float random(float min, float max)
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return min + (max - min) * static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+	}
+
+	void remove(std::size_t i)
+	{
+		std::size_t last = --count;
+		x[i] = x[last];
+		y[i] = y[last];
+		vx[i] = vx[last];
+		vy[i] = vy[last];
+		gravity[i] = gravity[last];
+		life[i] = life[last];
+		inv_life[i] = inv_life[last];
+		size[i] = size[last];
+		color[i] = color[last];
+		sprite[i] = sprite[last];
+	}
+
+    public:
+	Particles(const SDL::Texture &texture)
+		: texture(texture)
+		, x(capacity)
+		, y(capacity)
+		, vx(capacity)
+		, vy(capacity)
+		, gravity(capacity)
+		, life(capacity)
+		, inv_life(capacity)
+		, size(capacity)
+		, color(capacity)
+		, sprite(capacity)
+		, vertices(capacity * 4)
+		, indices(capacity * 6)
+	{
+		for (std::size_t i = 0; i < capacity; i++) {
+			int base = static_cast<int>(i * 4);
+			int *quad = &indices[i * 6];
+			quad[0] = base;
+			quad[1] = base + 1;
+			quad[2] = base + 2;
+			quad[3] = base;
+			quad[4] = base + 2;
+			quad[5] = base + 3;
+		}
+	}
+
+	// Registers a region of the texture particles can be drawn with.
+	int add_sprite(const SDL::Rect &src)
+	{
+		float w = static_cast<float>(texture.getWidth()), h = static_cast<float>(texture.getHeight());
+		sprites.push_back({ static_cast<float>(src.x) / w, static_cast<float>(src.y) / h,
+				    static_cast<float>(src.x + src.w) / w, static_cast<float>(src.y + src.h) / h });
+		return static_cast<int>(sprites.size() - 1);
+	}
+
+	// Emits n particles from (x, y) in random directions.
+	void burst(float px, float py, int n, const Style &style)
+	{
+		for (int k = 0; k < n && count < capacity; k++) {
+			std::size_t i = count++;
+			float angle = random(0, 2 * std::numbers::pi_v<float>);
+			float speed = random(style.speed_min, style.speed_max);
+			x[i] = px;
+			y[i] = py;
+			vx[i] = std::cos(angle) * speed;
+			vy[i] = std::sin(angle) * speed;
+			gravity[i] = style.gravity;
+			life[i] = random(style.life_min, style.life_max);
+			inv_life[i] = 1 / life[i];
+			size[i] = random(style.size_min, style.size_max);
+			color[i] = style.color;
+			sprite[i] = style.sprite;
+		}
+	}
+
+	void update(float dt)
+	{
+		std::size_t i = 0;
+#if defined(__SSE2__)
+		const __m128 step = _mm_set1_ps(dt);
+		for (; i + 4 <= count; i += 4) {
+			__m128 pvx = _mm_loadu_ps(&vx[i]);
+			__m128 pvy = _mm_add_ps(_mm_loadu_ps(&vy[i]), _mm_mul_ps(_mm_loadu_ps(&gravity[i]), step));
+			_mm_storeu_ps(&x[i], _mm_add_ps(_mm_loadu_ps(&x[i]), _mm_mul_ps(pvx, step)));
+			_mm_storeu_ps(&y[i], _mm_add_ps(_mm_loadu_ps(&y[i]), _mm_mul_ps(pvy, step)));
+			_mm_storeu_ps(&vy[i], pvy);
+			_mm_storeu_ps(&life[i], _mm_sub_ps(_mm_loadu_ps(&life[i]), step));
+		}
+#endif
+		for (; i < count; i++) {
+			vy[i] += gravity[i] * dt;
+			x[i] += vx[i] * dt;
+			y[i] += vy[i] * dt;
+			life[i] -= dt;
+		}
+
+		for (i = 0; i < count;) {
+			if (life[i] <= 0)
+				remove(i);
+			else
+				i++;
+		}
+	}
+
+	// Draws every particle, fading out over its life. Anything batched on the same
+	// renderer must be flushed first.
+	void draw(SDL::Renderer &renderer)
+	{
+		if (count == 0)
+			return;
+
+		for (std::size_t i = 0; i < count; i++) {
+			const Sprite &s = sprites[static_cast<std::size_t>(sprite[i])];
+			SDL::Color c = color[i];
+			c.a = static_cast<Uint8>(static_cast<float>(c.a) * std::fmin(life[i] * inv_life[i], 1.f));
+
+			float half = size[i] / 2;
+			float x0 = x[i] - half, y0 = y[i] - half, x1 = x[i] + half, y1 = y[i] + half;
+
+			SDL::Vertex *quad = &vertices[i * 4];
+			quad[0] = { { x0, y0 }, c, { s.u0, s.v0 } };
+			quad[1] = { { x1, y0 }, c, { s.u1, s.v0 } };
+			quad[2] = { { x1, y1 }, c, { s.u1, s.v1 } };
+			quad[3] = { { x0, y1 }, c, { s.u0, s.v1 } };
+		}
+
+		renderer.geometry(texture, std::span(vertices).first(count * 4), std::span(indices).first(count * 6));
+	}
+
+	std::size_t alive() const
+	{
+		return count;
+	}
+
+	void clear()
+	{
+		count = 0;
+	}
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+// Spsc_queue: Fixed size lock-free queue between exactly one producer thread and one
+// consumer thread. Neither side ever blocks or allocates: push() fails when the
+// queue is full and pop() returns nullopt when it is empty.
+template <typename T, std::size_t N> class Spsc_queue {
+	static_assert(N > 0 && (N & (N - 1)) == 0, "Spsc_queue size must be a power of two");
+
+    private:
+	std::array<T, N> items{};
+	// head is only written by the consumer and tail by the producer, on separate cache lines
+	alignas(64) std::atomic<std::size_t> head = 0;
+	alignas(64) std::atomic<std::size_t> tail = 0;
+
+    public:
+	bool push(const T &item)
+	{
+		std::size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == N)
+			return false;
+		items[t & (N - 1)] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	std::optional<T> pop()
+	{
+		std::size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return std::nullopt;
+		T item = items[h & (N - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return item;
+	}
+
+	// Number of items queued, exact on the producer side and an upper bound on the consumer side.
+	std::size_t size() const
+	{
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+	bool empty() const
+	{
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "sdl.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Recorder: Captures presented frames and writes them to disk from worker threads.
+//
+// Every Nth frame is read back into one of a fixed pool of pixel buffers and
+// handed to the workers, which encode it to "<directory>/frame_<n>.png" (or a raw
+// RGBA dump named after its size) and give the buffer back. The render thread
+// only pays for the read back: when every buffer is still being encoded, the
+// frame is dropped and counted rather than waited for.
+// Every frame presented while a recorder is active is captured, see SDL::Renderer::on_present.
+class Recorder {
+    public:
+	enum class Format { png, raw };
+
+	static inline Recorder *active = nullptr;
+
+    private:
+	struct Job {
+		std::size_t buffer;
+		Uint64 frame;
+		int w, h;
+	};
+
+	std::filesystem::path directory;
+	Uint64 every;
+	Format format;
+
+	std::vector<std::vector<SDL::Pixel> > buffers;
+	std::vector<std::size_t> free_buffers{};
+	std::deque<Job> jobs{};
+	std::mutex mutex{};
+	std::condition_variable ready{};
+	bool stopping = false;
+
+	Uint64 presented = 0;
+	Uint64 recorded = 0;
+	Uint64 dropped = 0;
+
+	std::vector<std::thread> workers{};
+
+	void encode(const Job &job, std::span<SDL::Pixel> pixels) const
+	{
+		char name[64];
+		if (format == Format::png) {
+			auto frame = static_cast<unsigned long long>(job.frame);
+			std::snprintf(name, sizeof(name), "frame_%06llu.png", frame);
+			SDL::Surface(pixels, job.w, job.h).savePNG((directory / name).string());
+		} else {
+			std::snprintf(name, sizeof(name), "frame_%06llu_%dx%d.rgba",
+				      static_cast<unsigned long long>(job.frame), job.w, job.h);
+			std::ofstream file(directory / name, std::ios::out | std::ios::binary);
+			file.write(reinterpret_cast<const char *>(pixels.data()),
+				   static_cast<std::streamsize>(pixels.size_bytes()));
+		}
+	}
+
+	void work()
+	{
+		std::unique_lock lock(mutex);
+		for (;;) {
+			ready.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (jobs.empty())
+				return;
+
+			Job job = jobs.front();
+			jobs.pop_front();
+			lock.unlock();
+
+			try {
+				auto &buffer = buffers[job.buffer];
+				encode(job, { buffer.data(), static_cast<std::size_t>(job.w * job.h) });
+			} catch (std::exception const &e) {
+				SDL::warn(std::string("Could not write frame: ") + e.what());
+			}
+
+			lock.lock();
+			free_buffers.push_back(job.buffer);
+		}
+	}
+
+    public:
+	Recorder(const std::string &directory, Uint64 every = 1, Format format = Format::png, std::size_t pool = 8,
+		 unsigned threads = 2)
+		: directory(directory)
+		, every(every > 0 ? every : 1)
+		, format(format)
+		, buffers(pool)
+	{
+		std::filesystem::create_directories(this->directory);
+		for (std::size_t i = 0; i < pool; i++)
+			free_buffers.push_back(i);
+		for (unsigned i = 0; i < threads; i++)
+			workers.emplace_back(&Recorder::work, this);
+		active = this;
+		SDL::Renderer::on_present = [](SDL::Renderer &renderer) { active->capture(renderer); };
+	}
+
+	Recorder(const Recorder &) = delete;
+	Recorder &operator=(const Recorder &) = delete;
+
+	// Writes the frames still queued before returning.
+	~Recorder()
+	{
+		if (active == this) {
+			active = nullptr;
+			SDL::Renderer::on_present = nullptr;
+		}
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		ready.notify_all();
+		for (auto &worker : workers)
+			worker.join();
+	}
+
+	// Reads the frame back, to be called right before it is presented.
+	void capture(SDL::Renderer &renderer)
+	{
+		Uint64 frame = presented++;
+		if (frame % every != 0)
+			return;
+
+		std::size_t index;
+		{
+			std::lock_guard lock(mutex);
+			if (free_buffers.empty()) {
+				dropped++;
+				return;
+			}
+			index = free_buffers.back();
+			free_buffers.pop_back();
+		}
+
+		// buffers only grow, the pool is allocated over the first frames and then reused
+		auto [w, h] = renderer.getOutputSize();
+		auto &buffer = buffers[index];
+		buffer.resize(std::max(buffer.size(), static_cast<std::size_t>(w * h)));
+		renderer.readPixels(buffer, w);
+
+		{
+			std::lock_guard lock(mutex);
+			jobs.push_back({ index, frame, w, h });
+			recorded++;
+		}
+		ready.notify_one();
+	}
+
+	Uint64 get_recorded() const
+	{
+		return recorded;
+	}
+
+	Uint64 get_dropped() const
+	{
+		return dropped;
+	}
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "exception.h"
+#include "sdl.h"
+
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+
+// Input_script: Input events injected at given frames of a headless run (see Virtual_clock).
+//
+// Scripts are text files with one "<frame> <kind> <args...>" line per event:
+//   key <keycode>   key press and release, e.g. "120 key 32" launches a ball
+//   move <x> <y>    mouse motion, in logical coordinates
+//   click <x> <y>   left button press and release, in logical coordinates
+//   quit            ends the run
+// Pushed events do not change the keyboard state, so the paddle follows the mouse.
+// Once the last event has been sent, the script keeps pushing SDL_QUIT.
+class Input_script {
+    private:
+	std::multimap<Uint64, SDL::Event> events{};
+
+	void add(Uint64 frame, SDL::Event event)
+	{
+		events.emplace(frame, event);
+	}
+
+    public:
+	void key(Uint64 frame, SDL::Keycode sym)
+	{
+		SDL::Event event{};
+		event.key.keysym.sym = sym;
+		event.key.state = SDL_PRESSED;
+		event.type = SDL_KEYDOWN;
+		add(frame, event);
+		event.key.state = SDL_RELEASED;
+		event.type = SDL_KEYUP;
+		add(frame, event);
+	}
+
+	void move(Uint64 frame, int x, int y)
+	{
+		SDL::Event event{};
+		event.type = SDL_MOUSEMOTION;
+		event.motion.x = x;
+		event.motion.y = y;
+		add(frame, event);
+	}
+
+	void click(Uint64 frame, int x, int y)
+	{
+		SDL::Event event{};
+		event.button.button = SDL_BUTTON_LEFT;
+		event.button.x = x;
+		event.button.y = y;
+		event.button.state = SDL_PRESSED;
+		event.type = SDL_MOUSEBUTTONDOWN;
+		add(frame, event);
+		event.button.state = SDL_RELEASED;
+		event.type = SDL_MOUSEBUTTONUP;
+		add(frame, event);
+	}
+
+	void quit(Uint64 frame)
+	{
+		SDL::Event event{};
+		event.type = SDL_QUIT;
+		add(frame, event);
+	}
+
+	static Input_script load(const std::string &file)
+	{
+		std::ifstream input(file, std::ios::in);
+		if (!input.is_open())
+			throw Bad_format();
+
+		Input_script script;
+		std::string line;
+		while (std::getline(input, line)) {
+			std::istringstream fields(line);
+			Uint64 frame;
+			std::string kind;
+			if (!(fields >> frame >> kind))
+				continue;
+
+			int a = 0, b = 0;
+			if (kind == "key" && fields >> a)
+				script.key(frame, a);
+			else if (kind == "move" && fields >> a >> b)
+				script.move(frame, a, b);
+			else if (kind == "click" && fields >> a >> b)
+				script.click(frame, a, b);
+			else if (kind == "quit")
+				script.quit(frame);
+			else
+				throw Bad_format();
+		}
+		return script;
+	}
+
+	// Sweeps the paddle around and launches a ball every second, for soak tests.
+	static Input_script random(Uint64 frames, unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<int> x(0, 300);
+
+		Input_script script;
+		for (Uint64 frame = 1; frame < frames; frame += 20)
+			script.move(frame, x(rng), 280);
+		for (Uint64 frame = 30; frame < frames; frame += 60)
+			script.key(frame, SDLK_SPACE);
+		script.quit(frames);
+		return script;
+	}
+
+	Uint64 length() const
+	{
+		return events.empty() ? 0 : events.rbegin()->first;
+	}
+
+	// Pushes the events of the given frame, to be installed as Virtual_clock::on_frame.
+	void operator()(Uint64 frame) const
+	{
+		if (frame > length()) {
+			SDL::Event event{};
+			event.type = SDL_QUIT;
+			SDL::pushEvent(event);
+			return;
+		}
+		auto [first, last] = events.equal_range(frame);
+		for (auto it = first; it != last; ++it) {
+			SDL::Event event = it->second;
+			SDL::pushEvent(event);
+		}
+	}
+};
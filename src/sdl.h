@@ -4,10 +4,14 @@
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 
+#include <cstring>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <span>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 namespace SDL
 {
@@ -84,11 +88,26 @@ inline void warn(const std::string &msg)
 	SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "%s: %s", msg.c_str(), getError().c_str());
 }
 
+inline void debug(const std::string &msg)
+{
+	SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION, "%s", msg.c_str());
+}
+
 inline void delay(Uint32 ms)
 {
 	SDL_Delay(ms);
 }
 
+inline Uint64 getPerformanceCounter()
+{
+	return SDL_GetPerformanceCounter();
+}
+
+inline Uint64 getPerformanceFrequency()
+{
+	return SDL_GetPerformanceFrequency();
+}
+
 inline std::optional<Event> pollEvent()
 {
 	Event e;
@@ -113,11 +132,50 @@ inline std::optional<Event> waitEventTimeout(int timeout)
 	return e;
 }
 
+inline void pushEvent(Event &event)
+{
+	if (SDL_PushEvent(&event) < 0)
+		fail("SDL_PushEvent");
+}
+
 inline void pumpEvents()
 {
 	SDL_PumpEvents();
 }
 
+// The watch is called as each event is queued, on the thread queueing it.
+inline void addEventWatch(SDL_EventFilter watch, void *userdata)
+{
+	SDL_AddEventWatch(watch, userdata);
+}
+
+inline void delEventWatch(SDL_EventFilter watch, void *userdata)
+{
+	SDL_DelEventWatch(watch, userdata);
+}
+
+// Removes every queued event of the given type and returns the most recent one.
+inline std::optional<Event> takeLastEvent(Uint32 type)
+{
+	std::optional<Event> last;
+	Event e;
+	while (SDL_PeepEvents(&e, 1, SDL_GETEVENT, type, type) > 0)
+		last = e;
+	return last;
+}
+
+inline bool hasIntersection(const Rect &a, const Rect &b)
+{
+	return SDL_HasIntersection(&a, &b) == SDL_TRUE;
+}
+
+inline Rect unionRect(const Rect &a, const Rect &b)
+{
+	Rect res;
+	SDL_UnionRect(&a, &b, &res);
+	return res;
+}
+
 inline bool setHint(const std::string &name, const std::string &value)
 {
 	return SDL_SetHint(name.c_str(), value.c_str()) == SDL_TRUE;
@@ -138,52 +196,86 @@ inline void free(char *filename)
 	SDL_free(filename);
 }
 
+// SDL: Reference count on the SDL, SDL_image and SDL_ttf libraries.
+// Every handle owned by a wrapper holds one reference, taken when the handle is
+// created and dropped by its deleter, so copying a wrapper costs no more than its
+// shared_ptr. The count and the initialization it guards are behind a mutex so that
+// worker threads can create surfaces while the main thread holds the libraries. An
+// SDL object can also be kept around to hold the libraries explicitly.
 class SDL {
     private:
+	static inline std::mutex mutex{};
 	static inline Uint32 count = 0;
 
     public:
-	SDL()
+	// Initializes the libraries for the first reference. When that fails nothing is
+	// left initialized nor counted, and the next call tries again.
+	static void acquire()
 	{
+		std::lock_guard lock(mutex);
 		if (count == 0) {
-			if (SDL_Init(SDL_INIT_VIDEO) != 0)
-				fail("SDL_Init");
-			if (IMG_Init(IMG_INIT_PNG) != IMG_INIT_PNG)
-				fail("IMG_Init");
-			if (TTF_Init() != 0)
-				fail("TTF_Init");
+			int initialized = 0;
+			try {
+				if (SDL_Init(SDL_INIT_VIDEO) != 0)
+					fail("SDL_Init");
+				initialized++;
+				if (IMG_Init(IMG_INIT_PNG) != IMG_INIT_PNG)
+					fail("IMG_Init");
+				initialized++;
+				if (TTF_Init() != 0)
+					fail("TTF_Init");
+			} catch (...) {
+				if (initialized >= 2)
+					IMG_Quit();
+				if (initialized >= 1)
+					SDL_Quit();
+				throw;
+			}
 		}
 		count++;
 	}
 
-	SDL(const SDL &)
+	static void release()
 	{
-		count++;
+		std::lock_guard lock(mutex);
+		if (--count == 0) {
+			IMG_Quit();
+			SDL_Quit();
+			TTF_Quit();
+		}
 	}
-	SDL(SDL &&)
+
+	SDL()
 	{
-		count++;
+		acquire();
 	}
-	SDL &operator=(const SDL &)
+	SDL(const SDL &)
 	{
-		return *this;
+		acquire();
 	}
-	SDL &operator=(SDL &&)
+	SDL &operator=(const SDL &)
 	{
 		return *this;
 	}
-
 	~SDL()
 	{
-		count--;
-		if (count == 0) {
-			IMG_Quit();
-			SDL_Quit();
-			TTF_Quit();
-		}
+		release();
 	}
 };
 
+// Wraps the handle returned by create(), making sure the libraries are initialized
+// before it is created and stay so until it is destroyed.
+template <auto destroy, typename F> auto own(F &&create)
+{
+	SDL::acquire();
+	auto *handle = create();
+	using T = std::remove_pointer_t<decltype(handle)>;
+	return std::shared_ptr<T>(handle, [](T *ptr) {
+		destroy(ptr);
+		SDL::release();
+	});
+}
+
 inline static bool isPressed(Scancode code)
 {
 	int len;
@@ -202,7 +294,6 @@ inline static bool isPressedMouse(Uint32 mask)
 
 class Window {
     private:
-	SDL sdl_{};
 	std::shared_ptr<SDL_Window> window_;
 
 	friend class Renderer;
@@ -214,7 +305,7 @@ class Window {
 
     public:
 	Window(SDL_Window *window)
-		: window_(window, SDL_DestroyWindow)
+		: window_(own<SDL_DestroyWindow>([&] { return window; }))
 	{
 	}
 
@@ -233,16 +324,17 @@ class Window {
 	}
 
 	Window(const std::string title, int x, int y, int w, int h, Uint32 flags = 0)
-		: window_(SDL_CreateWindow(title.c_str(), x, y, w, h, flags), SDL_DestroyWindow)
+		: window_(own<SDL_DestroyWindow>([&] { return SDL_CreateWindow(title.c_str(), x, y, w, h, flags); }))
 	{
 		if (window_ == nullptr)
 			fail("SDL_CreateWindow");
 	}
 
 	Window(const std::string title, int w, int h, Uint32 flags = 0)
-		: window_(SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, w, h,
-					   flags),
-			  SDL_DestroyWindow)
+		: window_(own<SDL_DestroyWindow>([&] {
+			return SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, w, h,
+						flags);
+		}))
 	{
 		if (window_ == nullptr)
 			fail("SDL_CreateWindow");
@@ -295,6 +387,15 @@ class Window {
 	{
 		SDL_SetWindowTitle(get(), title.c_str());
 	}
+
+	// Refresh rate of the display the window is on, 0 when unknown.
+	int getRefreshRate() const
+	{
+		SDL_DisplayMode mode;
+		if (SDL_GetWindowDisplayMode(get(), &mode) != 0)
+			return 0;
+		return mode.refresh_rate;
+	}
 };
 
 using Color = SDL_Color;
@@ -310,7 +411,6 @@ class Surface;
 
 class Renderer {
     private:
-	SDL sdl_{};
 	std::shared_ptr<SDL_Renderer> renderer_;
 
 	friend class Texture;
@@ -326,7 +426,7 @@ class Renderer {
 	Renderer &operator=(const Renderer &) = delete;
 	Renderer &operator=(Renderer &&) = default;
 	Renderer(Window &window, int index = -1, Uint32 flags = 0)
-		: renderer_(SDL_CreateRenderer(window.get(), index, flags), SDL_DestroyRenderer)
+		: renderer_(own<SDL_DestroyRenderer>([&] { return SDL_CreateRenderer(window.get(), index, flags); }))
 	{
 		if (renderer_ == nullptr)
 			fail("SDL_CreateRenderer");
@@ -338,11 +438,25 @@ class Renderer {
 		if (SDL_RenderClear(get()) != 0)
 			fail("SDL_RenderClear");
 	}
+	// Called with the finished frame right before every present(), e.g. to record it.
+	static inline void (*on_present)(Renderer &renderer) = nullptr;
+
 	void present()
 	{
+		if (on_present)
+			on_present(*this);
 		SDL_RenderPresent(get());
 	}
 
+	// Whether present() waits for the vertical blank.
+	bool hasVsync() const
+	{
+		SDL_RendererInfo info;
+		if (SDL_GetRendererInfo(get(), &info) != 0)
+			fail("SDL_GetRendererInfo");
+		return (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+	}
+
 	void setDrawBlendMode(BlendMode mode)
 	{
 		if (SDL_SetRenderDrawBlendMode(get(), mode) != 0)
@@ -479,12 +593,43 @@ class Renderer {
 				       indices.size()) != 0)
 			fail("SDL_RenderGeometry");
 	}
+	void geometry(const Texture &texture, std::span<const Vertex> vertices, std::span<const int> indices);
 
 	void getLogicalSize(int &w, int &h) const
 	{
 		SDL_RenderGetLogicalSize(get(), &w, &h);
 	}
 
+	// Size of the output in pixels, regardless of the logical size.
+	std::pair<int, int> getOutputSize() const
+	{
+		int w, h;
+		if (SDL_GetRendererOutputSize(get(), &w, &h) != 0)
+			fail("SDL_GetRendererOutputSize");
+		return { w, h };
+	}
+
+	// Reads the whole output back into pixels, w pixels per row, as sized by getOutputSize. Stalls until
+	// the GPU is done. SDL reads the viewport only, which a logical size shrinks to the letterboxed area,
+	// so the viewport is widened to the output for the read and restored after.
+	void readPixels(std::span<Pixel> pixels, int w)
+	{
+		int logical_w, logical_h;
+		getLogicalSize(logical_w, logical_h);
+		Rect viewport = getViewport();
+		if (SDL_RenderSetViewport(get(), nullptr) != 0)
+			fail("SDL_RenderSetViewport");
+		int result = SDL_RenderReadPixels(get(), nullptr, Pixel::format, pixels.data(),
+						  w * static_cast<int>(sizeof(Pixel)));
+		// the logical size recomputes the viewport it had exactly, a rect read back could be rounded
+		if (logical_w != 0)
+			setLogicalSize(logical_w, logical_h);
+		else
+			setViewport(viewport);
+		if (result != 0)
+			fail("SDL_RenderReadPixels");
+	}
+
 	void setLogicalSize(int w, int h)
 	{
 		if (SDL_RenderSetLogicalSize(get(), w, h) != 0)
@@ -528,6 +673,12 @@ class Renderer {
 			fail("SDL_RenderSetClipRect");
 	}
 
+	void resetClipRect()
+	{
+		if (SDL_RenderSetClipRect(get(), nullptr) != 0)
+			fail("SDL_RenderSetClipRect");
+	}
+
 	bool isClipEnabled() const
 	{
 		return SDL_RenderIsClipEnabled(get()) == SDL_TRUE;
@@ -561,7 +712,6 @@ class Renderer {
 
 class Surface {
     private:
-	SDL sdl_{};
 	std::shared_ptr<SDL_Surface> surface_;
 	friend class Texture;
 	friend class Renderer;
@@ -577,30 +727,55 @@ class Surface {
 	Surface &operator=(const Surface &) = default;
 	Surface &operator=(Surface &&) = default;
 	Surface(const std::string &file)
-		: surface_(IMG_Load(file.c_str()), SDL_FreeSurface)
+		: surface_(own<SDL_FreeSurface>([&] { return IMG_Load(file.c_str()); }))
 	{
 		if (surface_ == nullptr)
 			fail("IMG_Load");
 
 		if (surface_->format->format != Pixel::format) {
-			surface_.reset(SDL_ConvertSurfaceFormat(surface_.get(), Pixel::format, 0));
+			surface_ = own<SDL_FreeSurface>(
+				[&] { return SDL_ConvertSurfaceFormat(surface_.get(), Pixel::format, 0); });
 			if (surface_ == nullptr)
 				fail("SDL_ConvertSurfaceFormat");
 		}
 	}
 
 	Surface(SDL_Surface *surface)
-		: surface_(surface, SDL_FreeSurface)
+		: surface_(own<SDL_FreeSurface>([&] { return surface; }))
 	{
 	}
 
 	Surface(int w, int h)
-		: surface_(SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, Pixel::format), SDL_FreeSurface)
+		: surface_(own<SDL_FreeSurface>(
+			  [&] { return SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, Pixel::format); }))
 	{
 		if (surface_ == nullptr)
 			fail("SDL_CreateRGBSurface");
 	}
 
+	// Wraps pixels owned by the caller, which must outlive the surface.
+	Surface(std::span<Pixel> pixels, int w, int h)
+		: surface_(own<SDL_FreeSurface>([&] {
+			return SDL_CreateRGBSurfaceWithFormatFrom(pixels.data(), w, h, 32,
+								  w * static_cast<int>(sizeof(Pixel)), Pixel::format);
+		}))
+	{
+		if (surface_ == nullptr)
+			fail("SDL_CreateRGBSurfaceWithFormatFrom");
+	}
+
+	void setBlendMode(BlendMode mode)
+	{
+		if (SDL_SetSurfaceBlendMode(get(), mode) != 0)
+			fail("SDL_SetSurfaceBlendMode");
+	}
+
+	void savePNG(const std::string &file)
+	{
+		if (IMG_SavePNG(get(), file.c_str()) != 0)
+			fail("IMG_SavePNG");
+	}
+
 	void fillRect(const Rect &rect, Uint32 color)
 	{
 		if (SDL_FillRect(get(), &rect, color) != 0)
@@ -671,8 +846,10 @@ class Surface {
 
 class Texture {
     private:
-	SDL sdl_{};
 	std::shared_ptr<SDL_Texture> texture_;
+	// immutable for the lifetime of an SDL texture, queried once at creation
+	Uint32 format_ = 0;
+	int access_ = 0, w_ = 0, h_ = 0;
 
 	friend class Renderer;
 
@@ -681,35 +858,44 @@ class Texture {
 		return texture_.get();
 	}
 
+	void load_info()
+	{
+		if (SDL_QueryTexture(get(), &format_, &access_, &w_, &h_) != 0)
+			fail("SDL_QueryTexture");
+	}
+
     public:
 	Texture(const Texture &) = default;
 	Texture(Texture &&) = default;
 	Texture &operator=(const Texture &) = default;
 	Texture &operator=(Texture &&) = default;
-	Texture(Renderer &renderer, Surface surface)
-		: texture_(SDL_CreateTextureFromSurface(renderer.get(), surface.get()), SDL_DestroyTexture)
+	Texture(Renderer &renderer, const Surface &surface)
+		: texture_(own<SDL_DestroyTexture>(
+			  [&] { return SDL_CreateTextureFromSurface(renderer.get(), surface.get()); }))
 	{
 		if (texture_ == nullptr)
 			fail("SDL_CreateTextureFromSurface");
+		load_info();
 
-		Uint32 format;
-		SDL_QueryTexture(get(), &format, nullptr, nullptr, nullptr);
-		SDL_assert(format == Pixel::format);
-		if (format != Pixel::format)
+		SDL_assert(format_ == Pixel::format);
+		if (format_ != Pixel::format)
 			SDL_LogWarn(SDL_LOG_CATEGORY_RENDER, "Unsupported pixel format");
 	}
 	Texture(Renderer &renderer, int access, int w, int h)
-		: texture_(SDL_CreateTexture(renderer.get(), Pixel::format, access, w, h), SDL_DestroyTexture)
+		: texture_(own<SDL_DestroyTexture>(
+			  [&] { return SDL_CreateTexture(renderer.get(), Pixel::format, access, w, h); }))
 	{
 		if (texture_ == nullptr)
 			fail("SDL_CreateTexture");
+		load_info();
 	}
 
 	Texture(Renderer &renderer, const std::string &filename)
-		: texture_(IMG_LoadTexture(renderer.get(), filename.c_str()), SDL_DestroyTexture)
+		: texture_(own<SDL_DestroyTexture>([&] { return IMG_LoadTexture(renderer.get(), filename.c_str()); }))
 	{
 		if (texture_ == nullptr)
 			fail("IMG_LoadTexture");
+		load_info();
 	}
 
 	void update(const Rect &rect, const std::span<Pixel> pixels)
@@ -761,40 +947,42 @@ class Texture {
 
 	void query(Uint32 &format, int &access, int &w, int &h) const
 	{
-		if (SDL_QueryTexture(get(), &format, &access, &w, &h) != 0)
-			fail("SDL_QueryTexture");
+		format = format_;
+		access = access_;
+		w = w_;
+		h = h_;
 	}
 
 	void query(int &w, int &h) const
 	{
-		if (SDL_QueryTexture(get(), nullptr, nullptr, &w, &h) != 0)
-			fail("SDL_QueryTexture");
+		w = w_;
+		h = h_;
 	}
 
 	Rect getRect() const
 	{
-		Rect rect = { 0, 0, 0, 0 };
-		query(rect.w, rect.h);
-		return rect;
+		return { 0, 0, w_, h_ };
 	}
 
 	int getWidth() const
 	{
-		int w, h;
-		query(w, h);
-		return w;
+		return w_;
 	}
 
 	int getHeight() const
 	{
-		int w, h;
-		query(w, h);
-		return h;
+		return h_;
+	}
+
+	// Number of handles sharing this texture.
+	long useCount() const
+	{
+		return texture_.use_count();
 	}
 };
 
 inline Renderer::Renderer(Surface &surface)
-	: renderer_(SDL_CreateSoftwareRenderer(surface.get()), SDL_DestroyRenderer)
+	: renderer_(own<SDL_DestroyRenderer>([&] { return SDL_CreateSoftwareRenderer(surface.get()); }))
 {
 	if (renderer_ == nullptr)
 		fail("SDL_CreateSoftwareRenderer");
@@ -806,6 +994,13 @@ inline void Renderer::setTarget(Texture &texture)
 		fail("SDL_SetRenderTarget");
 }
 
+inline void Renderer::geometry(const Texture &texture, std::span<const Vertex> vertices, std::span<const int> indices)
+{
+	if (SDL_RenderGeometry(get(), texture.get(), vertices.data(), vertices.size(), indices.data(),
+			       indices.size()) != 0)
+		fail("SDL_RenderGeometry");
+}
+
 inline void Renderer::copy(const Texture &texture, const Rect &src, const Rect &dst)
 {
 	if (SDL_RenderCopy(get(), texture.get(), &src, &dst) != 0)
@@ -834,7 +1029,6 @@ inline void Renderer::copy(const Texture &texture, const Rect &src, const FRect
 
 class Font {
     private:
-	SDL sdl_{};
 	std::shared_ptr<TTF_Font> font_;
 
     public:
@@ -842,7 +1036,7 @@ class Font {
 	Font &operator=(const Font &) = delete;
 	Font &operator=(Font &&) = default;
 	Font(const std::string &file, int ptsize)
-		: font_(TTF_OpenFont(file.c_str(), ptsize), TTF_CloseFont)
+		: font_(own<TTF_CloseFont>([&] { return TTF_OpenFont(file.c_str(), ptsize); }))
 	{
 		if (font_ == nullptr)
 			fail("TTF_OpenFont");
@@ -854,5 +1048,104 @@ class Font {
 			fail("TTF_RenderText_Blended");
 		return Surface(surface);
 	}
+
+	Surface renderGlyph(Uint16 ch, const Color &color) const
+	{
+		SDL_Surface *surface = TTF_RenderGlyph_Blended(font_.get(), ch, color);
+		if (surface == nullptr)
+			fail("TTF_RenderGlyph_Blended");
+		return Surface(surface);
+	}
+
+	int glyphAdvance(Uint16 ch) const
+	{
+		int advance;
+		if (TTF_GlyphMetrics(font_.get(), ch, nullptr, nullptr, nullptr, nullptr, &advance) != 0)
+			fail("TTF_GlyphMetrics");
+		return advance;
+	}
+
+	int height() const
+	{
+		return TTF_FontHeight(font_.get());
+	}
 };
+
+// AudioDevice: Mono float output, filled by callback on SDL's audio thread.
+// SDL converts to whatever the hardware wants, so the format is always the one asked for.
+class AudioDevice {
+    private:
+	SDL_AudioDeviceID id = 0;
+	SDL_AudioSpec spec{};
+
+    public:
+	AudioDevice(int freq, Uint16 samples, SDL_AudioCallback callback, void *userdata)
+	{
+		SDL::acquire();
+		if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+			SDL::release();
+			fail("SDL_InitSubSystem");
+		}
+
+		SDL_AudioSpec want{};
+		want.freq = freq;
+		want.format = AUDIO_F32SYS;
+		want.channels = 1;
+		want.samples = samples;
+		want.callback = callback;
+		want.userdata = userdata;
+		id = SDL_OpenAudioDevice(nullptr, 0, &want, &spec, 0);
+		if (id == 0) {
+			SDL_QuitSubSystem(SDL_INIT_AUDIO);
+			SDL::release();
+			fail("SDL_OpenAudioDevice");
+		}
+	}
+
+	AudioDevice(const AudioDevice &) = delete;
+	AudioDevice &operator=(const AudioDevice &) = delete;
+
+	~AudioDevice()
+	{
+		SDL_CloseAudioDevice(id);
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		SDL::release();
+	}
+
+	void pause(bool paused)
+	{
+		SDL_PauseAudioDevice(id, paused ? 1 : 0);
+	}
+
+	int getFrequency() const
+	{
+		return spec.freq;
+	}
+};
+
+// Decodes a WAV file into mono float samples at freq.
+inline std::vector<float> loadWAV(const std::string &file, int freq)
+{
+	SDL_AudioSpec spec;
+	Uint8 *buffer;
+	Uint32 length;
+	if (SDL_LoadWAV(file.c_str(), &spec, &buffer, &length) == nullptr)
+		fail("SDL_LoadWAV");
+	std::unique_ptr<Uint8, decltype(&SDL_FreeWAV)> wav(buffer, SDL_FreeWAV);
+
+	SDL_AudioCVT cvt;
+	if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq, AUDIO_F32SYS, 1, freq) < 0)
+		fail("SDL_BuildAudioCVT");
+
+	std::vector<Uint8> data(static_cast<std::size_t>(length) * static_cast<std::size_t>(cvt.len_mult));
+	std::memcpy(data.data(), buffer, length);
+	cvt.buf = data.data();
+	cvt.len = static_cast<int>(length);
+	if (SDL_ConvertAudio(&cvt) != 0)
+		fail("SDL_ConvertAudio");
+
+	std::vector<float> samples(static_cast<std::size_t>(cvt.len_cvt) / sizeof(float));
+	std::memcpy(samples.data(), data.data(), samples.size() * sizeof(float));
+	return samples;
+}
 }; // namespace SDL
@@ -2,21 +2,26 @@
 
 #include "exception.h"
 #include "game.h"
+#include "pacer.h"
 #include "sdl.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <filesystem>
+#include <future>
+#include <limits>
 #include <memory>
-#include <sstream>
 #include <string>
 #include <vector>
 
-constexpr float y_shift = 20, y_off = 2;
+constexpr float x_off = 15, y_shift = 20, y_off = 2;
 
 std::shared_ptr<State> Selection::operator()()
 {
 	if (save_files.empty())
-		return std::make_shared<Game>(window, renderer);
+		return std::make_shared<Game>(window, renderer, states);
 
 	float y = 0;
 	bool is_redraw_needed = false;
@@ -24,7 +29,7 @@ std::shared_ptr<State> Selection::operator()()
 	draw();
 
 	for (;;) {
-		auto event = SDL::waitEvent();
+		auto event = Frame_pacer::next_event();
 
 		switch (event.type) {
 		case SDL_QUIT:
@@ -39,11 +44,7 @@ std::shared_ptr<State> Selection::operator()()
 				is_redraw_needed = true;
 			}
 			if (event.key.keysym.sym == SDLK_RETURN) {
-				try {
-					return std::make_shared<Game>(window, renderer, save_files[target].get_text());
-				} catch (Bad_format const &) {
-					return std::make_shared<Game>(window, renderer);
-				}
+				return load(save_files[target]);
 			}
 			break;
 		case SDL_MOUSEBUTTONDOWN:
@@ -60,13 +61,63 @@ std::shared_ptr<State> Selection::operator()()
 	}
 }
 
+// Parses the level on a worker thread while the screen keeps drawing a progress bar.
+// Only the parsed Logic crosses threads, textures are still created here by Game.
+std::shared_ptr<State> Selection::load(const std::string &save_file)
+{
+	std::atomic<float> progress = 0;
+	auto level = std::async(std::launch::async, [&] { return Logic::load(save_file, &progress); });
+
+	while (level.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		if (auto event = SDL::waitEventTimeout(16)) {
+			if (event->type == SDL_QUIT)
+				throw Close();
+		}
+		draw_progress(progress.load(std::memory_order_relaxed));
+	}
+
+	try {
+		return std::make_shared<Game>(window, renderer, states, save_file, level.get());
+	} catch (Bad_format const &) {
+		return std::make_shared<Game>(window, renderer, states);
+	}
+}
+
+Label &Selection::row(std::size_t index)
+{
+	auto &slot = rows[index % pool_size];
+
+	if (!slot)
+		slot = Row{ index, Label(save_files[index], font, fg, hl, renderer, 0, 0) };
+	else if (slot->index != index) {
+		slot->index = index;
+		slot->label.set_text(save_files[index], font, fg, hl, renderer);
+	}
+
+	return slot->label;
+}
+
 void Selection::draw()
 {
 	renderer.setDrawColor(bg);
 	renderer.clear();
 
-	for (size_t i = 0; i < save_files.size(); i++) {
-		save_files[i].draw(renderer, i == target);
+	std::size_t first = vert_shift;
+	std::size_t last = std::min<std::size_t>(save_files.size(), first + cursor_max + 1);
+
+	for (std::size_t i = first; i < last; i++) {
+		Label &label = row(i);
+		label.x = x_off;
+		label.y = y_off + static_cast<float>(i - first) * y_shift;
+		label.draw(renderer, i == target);
+	}
+
+	// warm up the rows just outside of the window so scrolling stays smooth
+	for (std::size_t i = 1; i <= row_margin; i++) {
+		if (first >= i)
+			row(first - i);
+		if (last - 1 + i < save_files.size())
+			row(last - 1 + i);
 	}
 
 	renderer.setDrawColor(cursor_color);
@@ -75,6 +126,20 @@ void Selection::draw()
 	renderer.present();
 }
 
+void Selection::draw_progress(float progress)
+{
+	constexpr SDL::FRect bar = { 100, 145, 200, 10 };
+
+	renderer.setDrawColor(bg);
+	renderer.clear();
+
+	renderer.setDrawColor(fg);
+	renderer.drawRect(bar);
+	renderer.fillRect(SDL::FRect{ bar.x, bar.y, bar.w * std::clamp(progress, 0.f, 1.f), bar.h });
+
+	renderer.present();
+}
+
 void Selection::up()
 {
 	if (target == 0)
@@ -84,8 +149,6 @@ void Selection::up()
 
 	if (cursor == 0) {
 		vert_shift--;
-		for (auto &file : save_files)
-			file.y = file.y + y_shift;
 	} else {
 		cursor--;
 	}
@@ -93,8 +156,6 @@ void Selection::up()
 
 void Selection::down()
 {
-	constexpr int cursor_max = 14;
-
 	if (target >= save_files.size() - 1)
 		return;
 
@@ -102,8 +163,6 @@ void Selection::down()
 
 	if (cursor >= cursor_max) {
 		vert_shift++;
-		for (auto &file : save_files)
-			file.y = file.y - y_shift;
 	} else {
 		cursor++;
 	}
@@ -119,19 +178,31 @@ void Selection::on_click(float y)
 	}
 }
 
-void Selection::init()
+// Lists the directory again only when a save was added or removed since the last visit.
+void Selection::on_enter()
 {
-	constexpr float x = 15;
-	float y = y_off;
-
-	for (const auto &entry : std::filesystem::directory_iterator("save")) {
-		std::ostringstream s;
-		s << entry.path();
+	auto time = std::filesystem::last_write_time("save");
+	if (scanned == time)
+		return;
+	scanned = time;
+	scan();
+}
 
-		std::string filename{ s.str() };
-		filename.erase(std::remove(filename.begin(), filename.end(), '\"'), filename.end());
+void Selection::scan()
+{
+	save_files.clear();
+	for (const auto &entry : std::filesystem::directory_iterator("save"))
+		save_files.emplace_back(entry.path().string());
+
+	// the rows may hold other files now, their textures are re-rendered on the next draw
+	for (auto &slot : rows) {
+		if (slot)
+			slot->index = std::numeric_limits<std::size_t>::max();
+	}
 
-		save_files.emplace_back(filename, font, fg, hl, renderer, x, y);
-		y = y + y_shift;
+	if (target >= save_files.size()) {
+		cursor = 0;
+		vert_shift = 0;
+		target = 0;
 	}
 }
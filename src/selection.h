@@ -4,25 +4,34 @@
 #include "sdl.h"
 #include "widget.h"
 
+#include <cstddef>
+#include <filesystem>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
-// Selection: Class to handle the selection screen.
+class States;
+
+// Selection: Class to handle the selection screen. Built once, see States: the listing,
+// its rendered rows and the position in it are kept between visits.
 class Selection : public State {
     public:
-	Selection(const SDL::Window &window, const SDL::Renderer &renderer)
+	Selection(const SDL::Window &window, const SDL::Renderer &renderer, States &states)
 		: window(window)
 		, renderer(renderer)
+		, states(states)
 	{
-		init();
 	};
 
+	void on_enter() override;
+
 	std::shared_ptr<State> operator()() override;
 
     private:
 	SDL::Window window;
 	SDL::Renderer renderer;
+	States &states;
 
 	static inline SDL::Font font{ "assets/ticketing.regular.ttf", 17 };
 	static constexpr SDL::Color bg = { 46, 36, 36, 255 };
@@ -30,17 +39,35 @@ class Selection : public State {
 	static constexpr SDL::Color hl = { 0xff, 0xe0, 0x7e, 0xff };
 	static constexpr SDL::Color cursor_color = { 0Xff, 0xe7, 0xd6, 128 };
 
+	static constexpr unsigned int cursor_max = 14;
+	static constexpr std::size_t row_margin = 2;
+	static constexpr std::size_t pool_size = cursor_max + 1 + 2 * row_margin;
+
 	unsigned int cursor = 0;
 	unsigned int vert_shift = 0;
 
-	std::vector<Label> save_files{};
+	std::vector<std::string> save_files{};
+	std::optional<std::filesystem::file_time_type> scanned{}; // of the save directory, when listed
 	unsigned int target = 0;
 
+	// Only the rows around the visible window own textures. Row i lives in slot
+	// i % pool_size and is re-rendered when the slot was holding another row.
+	struct Row {
+		std::size_t index;
+		Label label;
+	};
+	std::vector<std::optional<Row> > rows = std::vector<std::optional<Row> >(pool_size);
+
+	Label &row(std::size_t index);
+
 	void draw();
+	void draw_progress(float progress);
+
+	std::shared_ptr<State> load(const std::string &save_file);
 
 	void up();
 	void down();
 	void on_click(float y);
 
-	void init();
+	void scan();
 };
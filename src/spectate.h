@@ -0,0 +1,639 @@
+#pragma once
+
+#include "exception.h"
+#include "logic.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Stream_writer: Little endian and LEB128 encoding of the spectator stream.
+struct Stream_writer {
+	std::string bytes{};
+
+	void u8(unsigned value)
+	{
+		bytes.push_back(static_cast<char>(value & 0xff));
+	}
+
+	void u16(unsigned value)
+	{
+		u8(value);
+		u8(value >> 8);
+	}
+
+	void u32(std::uint32_t value)
+	{
+		u16(value & 0xffff);
+		u16(value >> 16);
+	}
+
+	void f32(float value)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		u32(bits);
+	}
+
+	void varint(std::uint64_t value)
+	{
+		for (; value >= 0x80; value >>= 7)
+			u8(static_cast<unsigned>(value & 0x7f) | 0x80);
+		u8(static_cast<unsigned>(value));
+	}
+};
+
+// Stream_reader: Reads what Stream_writer wrote, throws Bad_format past the end.
+class Stream_reader {
+    private:
+	std::string_view bytes;
+	std::size_t pos = 0;
+
+    public:
+	Stream_reader(std::string_view bytes)
+		: bytes(bytes)
+	{
+	}
+
+	unsigned u8()
+	{
+		if (pos >= bytes.size())
+			throw Bad_format();
+		return static_cast<unsigned char>(bytes[pos++]);
+	}
+
+	unsigned u16()
+	{
+		unsigned low = u8();
+		return low | u8() << 8;
+	}
+
+	std::uint32_t u32()
+	{
+		std::uint32_t low = u16();
+		return low | std::uint32_t(u16()) << 16;
+	}
+
+	float f32()
+	{
+		std::uint32_t bits = u32();
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	std::uint64_t varint()
+	{
+		std::uint64_t value = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7) {
+			unsigned byte = u8();
+			value |= std::uint64_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return value;
+		}
+		throw Bad_format();
+	}
+
+	// A count of items taking at least one byte each, so a corrupt count cannot allocate much.
+	std::size_t count()
+	{
+		std::uint64_t n = varint();
+		if (n > bytes.size() - pos)
+			throw Bad_format();
+		return static_cast<std::size_t>(n);
+	}
+
+	// A new size for a list of `size` items, each added item taking at least one byte.
+	std::size_t grow(std::size_t size)
+	{
+		std::uint64_t n = varint();
+		if (n < size || n - size > bytes.size() - pos)
+			throw Bad_format();
+		return static_cast<std::size_t>(n);
+	}
+};
+
+// Stream_state: What spectators see of a Logic, positions quantized to 16 bits.
+//
+// A snapshot holds every object. A delta holds the header and the paddles, then only
+// the balls and powerups whose quantized position or state changed and the bricks
+// whose durability changed, each addressed by its distance to the previous one. Bricks
+// never move and are never removed, so after the snapshot they cost a few bytes per hit.
+struct Stream_state {
+	struct Point {
+		std::uint16_t x = 0, y = 0;
+
+		bool operator==(const Point &) const = default;
+	};
+
+	struct Brick_state {
+		Point pos{};
+		std::uint8_t shape = 0, dura = 0;
+	};
+
+	struct Powerup_state {
+		Point pos{};
+		std::uint8_t type = 0;
+		bool alive = false;
+
+		bool operator==(const Powerup_state &) const = default;
+	};
+
+	enum Kind : std::uint8_t { snapshot = 1, delta = 2 };
+
+	// position of dead balls
+	static constexpr Point dead = { 0xffff, 0xffff };
+
+	float w = 0, h = 0;
+	float scale = 1; // world units per quantization step
+	std::uint32_t tick = 0, score = 0;
+	std::uint8_t lives = 0, state = 0;
+	std::vector<Point> paddles{};
+	std::vector<Point> balls{};
+	std::vector<Brick_state> bricks{};
+	std::vector<Powerup_state> powerups{};
+
+	// a quarter of a pixel, or coarser for worlds wider than 16k pixels
+	static float scale_for(float w, float h)
+	{
+		return std::max(0.25f, std::max(w, h) / 0xfff0);
+	}
+
+	Point quantize(float x, float y) const
+	{
+		auto q = [this](float v) {
+			return static_cast<std::uint16_t>(std::clamp(std::lround(v / scale), 0L, 0xfffeL));
+		};
+		return { q(x), q(y) };
+	}
+
+	static Stream_state capture(const Logic &logic)
+	{
+		Stream_state s;
+		s.w = logic.get_width();
+		s.h = logic.get_height();
+		s.scale = scale_for(s.w, s.h);
+		s.tick = static_cast<std::uint32_t>(std::max(logic.get_tick(), 0));
+		s.score = static_cast<std::uint32_t>(std::max(logic.get_score(), 0));
+		s.lives = static_cast<std::uint8_t>(std::clamp(logic.get_lives(), 0, 255));
+		s.state = static_cast<std::uint8_t>(logic.get_state());
+
+		for (const auto &paddle : logic.get_paddles())
+			s.paddles.push_back(s.quantize(paddle.get_x(), paddle.get_y()));
+		s.balls.reserve(logic.get_balls().size());
+		for (const auto &ball : logic.get_balls())
+			s.balls.push_back(ball.is_alive() ? s.quantize(ball.get_x(), ball.get_y()) : dead);
+		s.bricks.reserve(logic.get_bricks().size());
+		for (const auto &brick : logic.get_bricks())
+			s.bricks.push_back({ s.quantize(brick.get_x(), brick.get_y()),
+					     static_cast<std::uint8_t>(brick.get_form()),
+					     static_cast<std::uint8_t>(std::min(brick.get_durability(), 255u)) });
+		for (const auto &powerup : logic.get_powerups())
+			s.powerups.push_back({ s.quantize(powerup.get_x(), powerup.get_y()),
+					       static_cast<std::uint8_t>(powerup.get_power()), powerup.is_alive() });
+		return s;
+	}
+
+	// Whether a delta from `other` can describe this state.
+	bool follows(const Stream_state &other) const
+	{
+		return w == other.w && h == other.h && tick >= other.tick && bricks.size() == other.bricks.size() &&
+		       balls.size() >= other.balls.size() && powerups.size() >= other.powerups.size();
+	}
+
+    private:
+	static void point(Stream_writer &out, Point p)
+	{
+		out.u16(p.x);
+		out.u16(p.y);
+	}
+
+	void header(Stream_writer &out) const
+	{
+		out.varint(tick);
+		out.varint(score);
+		out.u8(lives);
+		out.u8(state);
+		out.varint(paddles.size());
+		for (auto p : paddles)
+			point(out, p);
+	}
+
+	// Writes the indices where `changed` holds, each as the distance to the previous one.
+	template <typename F, typename W> static void changes(Stream_writer &out, std::size_t n, F &&changed, W &&write)
+	{
+		std::size_t count = 0;
+		for (std::size_t i = 0; i < n; i++)
+			count += changed(i);
+		out.varint(count);
+		for (std::size_t i = 0, next = 0; i < n; i++) {
+			if (!changed(i))
+				continue;
+			out.varint(i - next);
+			write(i);
+			next = i + 1;
+		}
+	}
+
+    public:
+	void encode_snapshot(Stream_writer &out) const
+	{
+		out.u8(snapshot);
+		out.f32(w);
+		out.f32(h);
+		header(out);
+		out.varint(balls.size());
+		for (auto p : balls)
+			point(out, p);
+		out.varint(bricks.size());
+		for (const auto &b : bricks) {
+			point(out, b.pos);
+			out.u8(b.shape);
+			out.u8(b.dura);
+		}
+		out.varint(powerups.size());
+		for (const auto &p : powerups) {
+			point(out, p.pos);
+			out.u8(p.type | (p.alive ? 0x80u : 0u));
+		}
+	}
+
+	// Only valid when follows(prev).
+	void encode_delta(const Stream_state &prev, Stream_writer &out) const
+	{
+		out.u8(delta);
+		header(out);
+
+		out.varint(balls.size());
+		changes(
+			out, balls.size(),
+			[&](std::size_t i) { return i >= prev.balls.size() || balls[i] != prev.balls[i]; },
+			[&](std::size_t i) { point(out, balls[i]); });
+
+		changes(
+			out, bricks.size(), [&](std::size_t i) { return bricks[i].dura != prev.bricks[i].dura; },
+			[&](std::size_t i) { out.u8(bricks[i].dura); });
+
+		out.varint(powerups.size());
+		changes(
+			out, powerups.size(),
+			[&](std::size_t i) { return i >= prev.powerups.size() || powerups[i] != prev.powerups[i]; },
+			[&](std::size_t i) {
+				point(out, powerups[i].pos);
+				out.u8(powerups[i].type | (powerups[i].alive ? 0x80u : 0u));
+			});
+	}
+};
+
+// Spectator_server: Streams the game to spectators connected over TCP.
+//
+// A spectator joining gets a snapshot, then one delta per published tick. Deltas are
+// encoded once and sent to every spectator, each through its own non-blocking
+// backlog, so a slow spectator never stalls the game; one falling too far behind is
+// disconnected. When deltas outgrow `budget`, ticks are skipped and the next delta
+// covers them, so the stream degrades in frame rate rather than in bandwidth.
+// Games publish every tick to the server held by States.
+class Spectator_server {
+    public:
+	// bytes per second sent to each spectator, snapshots aside
+	static constexpr double budget = 32 * 1024;
+
+    private:
+	struct Client {
+		int fd;
+		std::string pending;
+	};
+
+	static constexpr std::size_t max_backlog = 1 << 20;
+
+	int fd = -1;
+	double rate;
+	std::vector<Client> clients{};
+	const Logic *source = nullptr;
+	Stream_state last{};
+	std::string snapshot{};
+	bool snapshot_current = false; // snapshot is that of last
+	double credit = 0;
+	std::uint64_t sent = 0;
+
+	[[noreturn]] static void fail(const std::string &what)
+	{
+		throw std::runtime_error(what + ": " + std::strerror(errno));
+	}
+
+	static std::string frame(const Stream_writer &message)
+	{
+		Stream_writer out;
+		out.u32(static_cast<std::uint32_t>(message.bytes.size()));
+		return out.bytes + message.bytes;
+	}
+
+	// False when the spectator is gone or too far behind.
+	bool flush(Client &client)
+	{
+		while (!client.pending.empty()) {
+			ssize_t n = ::send(client.fd, client.pending.data(), client.pending.size(), MSG_NOSIGNAL);
+			if (n < 0)
+				return errno == EAGAIN || errno == EWOULDBLOCK;
+			client.pending.erase(0, static_cast<std::size_t>(n));
+			sent += static_cast<std::size_t>(n);
+		}
+		return client.pending.size() <= max_backlog + snapshot.size();
+	}
+
+	void broadcast(const std::string &message)
+	{
+		for (auto &client : clients)
+			client.pending += message;
+	}
+
+    public:
+	// Listens on port, any free port when 0. rate is the number of ticks published per second.
+	Spectator_server(std::uint16_t port = 0, double rate = 60)
+		: rate(rate)
+	{
+		fd = ::socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0)
+			fail("socket");
+		int yes = 1;
+		::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons(port);
+		if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(fd, 16) < 0 ||
+		    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+			::close(fd);
+			fail("listen");
+		}
+	}
+
+	Spectator_server(const Spectator_server &) = delete;
+	Spectator_server &operator=(const Spectator_server &) = delete;
+
+	~Spectator_server()
+	{
+		for (auto &client : clients)
+			::close(client.fd);
+		::close(fd);
+	}
+
+	std::uint16_t local_port() const
+	{
+		sockaddr_in addr{};
+		socklen_t len = sizeof(addr);
+		if (::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) < 0)
+			fail("getsockname");
+		return ntohs(addr.sin_port);
+	}
+
+	// Sends the state after a tick of logic to the spectators.
+	void publish(const Logic &logic)
+	{
+		std::vector<int> joining;
+		for (int client; (client = ::accept(fd, nullptr, nullptr)) >= 0;) {
+			::fcntl(client, F_SETFL, ::fcntl(client, F_GETFL) | O_NONBLOCK);
+			joining.push_back(client);
+		}
+		if (clients.empty() && joining.empty()) {
+			// nothing is kept while nobody watches
+			source = nullptr;
+			return;
+		}
+
+		constexpr double burst = budget / 4;
+		credit = std::min(credit + budget / rate, burst);
+
+		Stream_state state = Stream_state::capture(logic);
+		if (source != &logic || !state.follows(last)) {
+			// another game, or the same one restarted
+			source = &logic;
+			last = std::move(state);
+			Stream_writer message;
+			last.encode_snapshot(message);
+			snapshot = frame(message);
+			snapshot_current = true;
+			broadcast(snapshot);
+		} else {
+			Stream_writer message;
+			state.encode_delta(last, message);
+			auto size = static_cast<double>(message.bytes.size());
+			// a delta larger than the burst still goes out once it is reached, as a debt
+			if (credit >= size || credit >= burst) {
+				credit -= size;
+				last = std::move(state);
+				snapshot_current = false;
+				broadcast(frame(message));
+			}
+		}
+
+		for (int client : joining) {
+			if (!snapshot_current) {
+				Stream_writer message;
+				last.encode_snapshot(message);
+				snapshot = frame(message);
+				snapshot_current = true;
+			}
+			clients.push_back({ client, snapshot });
+		}
+
+		std::erase_if(clients, [this](Client &client) {
+			if (flush(client))
+				return false;
+			::close(client.fd);
+			return true;
+		});
+	}
+
+	std::size_t get_spectators() const
+	{
+		return clients.size();
+	}
+
+	std::uint64_t get_sent_bytes() const
+	{
+		return sent;
+	}
+};
+
+// Spectator_view: Mirrors into a Logic the game streamed by a Spectator_server. The
+// mirrored Logic is only drawn, never stepped.
+class Spectator_view {
+    public:
+	enum Result {
+		lost,	  // the host is gone or sent something unreadable
+		updated,  // deltas applied, or nothing new
+		resynced, // a snapshot was applied, the whole scene may have changed
+	};
+
+	// Longest message accepted, a snapshot of about a million bricks. A longer length is taken
+	// for a corrupt stream rather than waited for.
+	static constexpr std::size_t max_message = 8 << 20;
+
+    private:
+	int fd = -1;
+	std::string buffer{};
+	Stream_state state{}; // as last received
+	bool synced = false;  // a snapshot was received
+
+	static Stream_state::Point point(Stream_reader &in)
+	{
+		auto x = static_cast<std::uint16_t>(in.u16());
+		return { x, static_cast<std::uint16_t>(in.u16()) };
+	}
+
+	static Stream_state::Powerup_state powerup(Stream_reader &in)
+	{
+		auto pos = point(in);
+		unsigned flags = in.u8();
+		return { pos, static_cast<std::uint8_t>(flags & 0x7fu), (flags & 0x80) != 0 };
+	}
+
+	void header(Stream_reader &in)
+	{
+		state.tick = static_cast<std::uint32_t>(in.varint());
+		state.score = static_cast<std::uint32_t>(in.varint());
+		state.lives = static_cast<std::uint8_t>(in.u8());
+		state.state = static_cast<std::uint8_t>(in.u8());
+		state.paddles.resize(in.count());
+		for (auto &p : state.paddles)
+			p = point(in);
+	}
+
+	// Reads the changed indices written by Stream_state::changes.
+	template <typename F> static void changes(Stream_reader &in, std::size_t n, F &&read)
+	{
+		for (std::size_t i = 0, count = in.count(), next = 0; i < count; i++) {
+			std::size_t index = next + static_cast<std::size_t>(in.varint());
+			if (index >= n)
+				throw Bad_format();
+			read(index);
+			next = index + 1;
+		}
+	}
+
+	// Decodes a message into the state as last received. True for a snapshot.
+	bool apply(std::string_view message)
+	{
+		Stream_reader in(message);
+		unsigned kind = in.u8();
+		if (kind == Stream_state::snapshot) {
+			state.w = in.f32();
+			state.h = in.f32();
+			state.scale = Stream_state::scale_for(state.w, state.h);
+			header(in);
+
+			state.balls.resize(in.count());
+			for (auto &p : state.balls)
+				p = point(in);
+
+			state.bricks.resize(in.count());
+			for (auto &b : state.bricks) {
+				b.pos = point(in);
+				b.shape = static_cast<std::uint8_t>(in.u8());
+				b.dura = static_cast<std::uint8_t>(in.u8());
+			}
+
+			state.powerups.resize(in.count());
+			for (auto &p : state.powerups)
+				p = powerup(in);
+			synced = true;
+			return true;
+		} else if (kind == Stream_state::delta && synced) {
+			header(in);
+
+			state.balls.resize(in.grow(state.balls.size()));
+			changes(in, state.balls.size(), [&](std::size_t i) { state.balls[i] = point(in); });
+
+			changes(in, state.bricks.size(),
+				[&](std::size_t i) { state.bricks[i].dura = static_cast<std::uint8_t>(in.u8()); });
+
+			state.powerups.resize(in.grow(state.powerups.size()));
+			changes(in, state.powerups.size(), [&](std::size_t i) { state.powerups[i] = powerup(in); });
+			return false;
+		} else {
+			throw Bad_format();
+		}
+	}
+
+    public:
+	Spectator_view(const std::string &host, std::uint16_t port)
+	{
+		addrinfo hints{};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo *res = nullptr;
+		if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) != 0 || !res)
+			throw std::runtime_error("Unknown host " + host);
+		fd = ::socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+		bool connected = fd >= 0 && ::connect(fd, res->ai_addr, res->ai_addrlen) == 0;
+		::freeaddrinfo(res);
+		if (!connected) {
+			if (fd >= 0)
+				::close(fd);
+			throw std::runtime_error("Could not connect to " + host + ": " + std::strerror(errno));
+		}
+		::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+	}
+
+	Spectator_view(const Spectator_view &) = delete;
+	Spectator_view &operator=(const Spectator_view &) = delete;
+
+	~Spectator_view()
+	{
+		::close(fd);
+	}
+
+	// Applies every complete message received so far to logic.
+	Result update(Logic &logic)
+	{
+		bool open = true;
+		char chunk[1 << 16];
+		for (;;) {
+			ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+			if (n > 0) {
+				buffer.append(chunk, static_cast<std::size_t>(n));
+				continue;
+			}
+			open = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+			break;
+		}
+
+		std::size_t pos = 0;
+		bool applied = false, snapshot = false;
+		try {
+			while (buffer.size() - pos >= 4) {
+				std::size_t size = Stream_reader(std::string_view(buffer).substr(pos, 4)).u32();
+				if (size > max_message)
+					return lost;
+				if (buffer.size() - pos - 4 < size)
+					break;
+				snapshot |= apply(std::string_view(buffer).substr(pos + 4, size));
+				applied = true;
+				pos += 4 + size;
+			}
+		} catch (Bad_format const &) {
+			return lost;
+		}
+		buffer.erase(0, pos);
+		if (applied)
+			logic.mirror(state);
+		if (!open)
+			return lost;
+		return snapshot ? resynced : updated;
+	}
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "editor.h"
+#include "mainscreen.h"
+#include "sdl.h"
+#include "selection.h"
+
+#include <memory>
+#include <utility>
+
+class Spectator_server;
+
+// States: The menu screens, built once in main and returned by every transition to them,
+// so moving between menus neither allocates nor renders their labels again. A Game owns
+// the level it plays and is still created per transition; every game publishes its ticks
+// to server when there is one.
+struct States {
+	std::shared_ptr<MainScreen> main_screen;
+	std::shared_ptr<Selection> selection;
+	std::shared_ptr<Editor> editor;
+	std::shared_ptr<Spectator_server> server;
+
+	// The screens keep a reference to the holder, which must outlive the FSM running them.
+	States(const SDL::Window &w, const SDL::Renderer &r, std::shared_ptr<Spectator_server> server = nullptr)
+		: main_screen(std::make_shared<MainScreen>(w, r, *this))
+		, selection(std::make_shared<Selection>(w, r, *this))
+		, editor(std::make_shared<Editor>(w, r, *this))
+		, server(std::move(server))
+	{
+	}
+
+	States(const States &) = delete;
+	States &operator=(const States &) = delete;
+};
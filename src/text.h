@@ -0,0 +1,106 @@
+#pragma once
+
+#include "batch.h"
+#include "sdl.h"
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include <vector>
+
+// Glyph_atlas: Printable ASCII glyphs of a font baked once into a single texture.
+//
+// Glyphs are rendered in white and tinted through the vertex color, so one atlas
+// serves every color. Text drawn with it costs one quad per character in the
+// sprite batch instead of a TTF render and a texture upload.
+class Glyph_atlas {
+    private:
+	struct Glyph {
+		SDL::Rect src;
+		int advance;
+	};
+
+	static constexpr char first = ' ', last = '~';
+	static constexpr int width = 512;
+
+	std::array<Glyph, last - first + 1> glyphs{};
+	int line_height;
+	SDL::Texture texture;
+
+	SDL::Surface bake(const SDL::Font &font)
+	{
+		constexpr SDL::Color white = { 255, 255, 255, 255 };
+
+		std::vector<SDL::Surface> surfaces;
+		surfaces.reserve(glyphs.size());
+
+		int x = 0, y = 0, shelf = 0;
+		for (char c = first; c <= last; c++) {
+			auto ch = static_cast<Uint16>(c);
+			SDL::Surface &surface = surfaces.emplace_back(font.renderGlyph(ch, white));
+			surface.setBlendMode(SDL_BLENDMODE_NONE);
+
+			int w = surface.getWidth(), h = surface.getHeight();
+			if (x + w > width) {
+				x = 0;
+				y += shelf + 1;
+				shelf = 0;
+			}
+			glyphs[static_cast<std::size_t>(c - first)] = { { x, y, w, h }, font.glyphAdvance(ch) };
+			x += w + 1;
+			shelf = std::max(shelf, h);
+		}
+
+		SDL::Surface atlas(width, y + shelf);
+		for (std::size_t i = 0; i < glyphs.size(); i++) {
+			SDL::Rect dst = glyphs[i].src;
+			SDL::Surface::blit(surfaces[i], { 0, 0, dst.w, dst.h }, atlas, dst);
+		}
+		return atlas;
+	}
+
+	const Glyph &glyph(char c) const
+	{
+		if (c < first || c > last)
+			c = '?';
+		return glyphs[static_cast<std::size_t>(c - first)];
+	}
+
+    public:
+	Glyph_atlas(SDL::Renderer &renderer, const SDL::Font &font)
+		: line_height(font.height())
+		, texture(renderer, bake(font))
+	{
+		texture.setBlendMode(SDL_BLENDMODE_BLEND);
+	}
+
+	// Size of the text as TTF_RenderText would produce it, before scaling.
+	SDL::Point measure(std::string_view text) const
+	{
+		int w = 0;
+		for (char c : text)
+			w += glyph(c).advance;
+		return { w, line_height };
+	}
+
+	// Draws text with its top-left corner at (x, y).
+	void draw(Sprite_batch &batch, std::string_view text, float x, float y, const SDL::Color &color,
+		  float scale = 1) const
+	{
+		for (char c : text) {
+			const Glyph &g = glyph(c);
+			float w = static_cast<float>(g.src.w) * scale, h = static_cast<float>(g.src.h) * scale;
+			batch.draw(texture, g.src, { x, y, w, h }, color);
+			x += static_cast<float>(g.advance) * scale;
+		}
+	}
+
+	// Draws text centered on (x, y).
+	void draw_centered(Sprite_batch &batch, std::string_view text, float x, float y, const SDL::Color &color,
+			   float scale = 1) const
+	{
+		SDL::Point size = measure(text);
+		float w = static_cast<float>(size.x) * scale, h = static_cast<float>(size.y) * scale;
+		draw(batch, text, x - w / 2, y - h / 2, color, scale);
+	}
+};
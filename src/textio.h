@@ -0,0 +1,161 @@
+#pragma once
+
+#include "exception.h"
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <fstream>
+#include <istream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+// Text_writer: Append-only text buffer formatting numbers with std::to_chars.
+// Floats use the same "%g" precision as the default ostream formatting so the
+// produced files are byte-identical to the previous iostream based writer.
+class Text_writer {
+    private:
+	std::string buffer{};
+
+	template <typename T> void append(T value)
+	{
+		char tmp[32];
+		std::to_chars_result res;
+		if constexpr (std::floating_point<T>)
+			res = std::to_chars(tmp, tmp + sizeof(tmp), value, std::chars_format::general, 6);
+		else
+			res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+		buffer.append(tmp, res.ptr);
+	}
+
+    public:
+	void reserve(std::size_t size)
+	{
+		buffer.reserve(size);
+	}
+
+	Text_writer &put(char c)
+	{
+		buffer.push_back(c);
+		return *this;
+	}
+
+	template <typename T>
+		requires std::integral<T> || std::floating_point<T>
+	Text_writer &write(T value)
+	{
+		append(value);
+		return *this;
+	}
+
+	// Writes every value separated by a comma and terminates the record with a newline.
+	template <typename... T> Text_writer &record(T... values)
+	{
+		bool first = true;
+		((first ? (void)(first = false) : (void)put(','), write(values)), ...);
+		return put('\n');
+	}
+
+	std::string_view view() const
+	{
+		return buffer;
+	}
+
+	void flush(std::ostream &output) const
+	{
+		output.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	}
+};
+
+// Text_reader: Single-pass reader over a whole-file buffer using std::from_chars.
+// It mirrors the behaviour of the formatted extraction / ignore sequence it replaces:
+// leading whitespace is skipped before a number and skip() consumes everything up to and
+// including the delimiter. Running out of input or a malformed number throws Bad_format.
+class Text_reader {
+    private:
+	const char *begin;
+	const char *cur;
+	const char *end;
+
+	static constexpr bool is_space(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+	}
+
+    public:
+	Text_reader(std::string_view text)
+		: begin(text.data())
+		, cur(text.data())
+		, end(text.data() + text.size())
+	{
+	}
+
+	template <typename T>
+		requires std::integral<T> || std::floating_point<T>
+	T read()
+	{
+		while (cur != end && is_space(*cur))
+			cur++;
+		if (cur != end && *cur == '+')
+			cur++;
+
+		T value{};
+		auto [ptr, ec] = std::from_chars(cur, end, value);
+		if (ec != std::errc())
+			throw Bad_format();
+		cur = ptr;
+		return value;
+	}
+
+	template <typename T> void read(T &value)
+	{
+		value = read<T>();
+	}
+
+	void skip(char delim)
+	{
+		while (cur != end && *cur != delim)
+			cur++;
+		if (cur == end)
+			throw Bad_format();
+		cur++;
+	}
+
+	bool eof() const
+	{
+		return cur == end;
+	}
+
+	// Fraction of the buffer consumed so far, in [0, 1].
+	float progress() const
+	{
+		if (begin == end)
+			return 1;
+		return static_cast<float>(cur - begin) / static_cast<float>(end - begin);
+	}
+};
+
+inline std::string read_file(const std::string &filename)
+{
+	std::ifstream file(filename, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		throw Bad_format();
+
+	std::string content;
+	file.seekg(0, std::ios::end);
+	auto size = file.tellg();
+	if (size > 0) {
+		content.resize(static_cast<std::size_t>(size));
+		file.seekg(0, std::ios::beg);
+		file.read(content.data(), size);
+		content.resize(static_cast<std::size_t>(file.gcount()));
+	}
+	return content;
+}
+
+inline std::string read_stream(std::istream &input)
+{
+	return { std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+}
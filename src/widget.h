@@ -1,8 +1,16 @@
 #pragma once
 
+#include "cache.h"
 #include "sdl.h"
+#include "text.h"
 
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 class Label {
     private:
@@ -68,6 +76,7 @@ class UI_Factory {
     private:
 	SDL::Texture sprites;
 	SDL::Font font = SDL::Font("assets/mag.ttf", 32);
+	Glyph_atlas glyphs;
 
 	SDL::Texture create_box(SDL::Renderer &renderer, int w, int h, int dim, int off_x, int off_y)
 	{
@@ -150,32 +159,75 @@ class UI_Factory {
 		return texture;
 	}
 
-    public:
-	UI_Factory(SDL::Renderer &renderer)
-		: sprites(renderer, "assets/ui.png")
-	{
-	}
+	// Generated textures are memoized, keyed by what they were generated from.
+	enum class Kind {
+		big_box,
+		button_box,
+		button_over_box,
+		button,
+		button_over,
+		label,
+		home_button,
+		home_button_over,
+		restart_button,
+		restart_button_over,
+	};
 
-	SDL::Texture create_big_box(SDL::Renderer &renderer, int w, int h)
-	{
-		return create_box(renderer, w, h, 16, 0, 0);
-	}
+	struct Key {
+		Kind kind;
+		std::string text;
+		int w, h;
+		Uint32 style;
 
-	SDL::Texture create_button_box(SDL::Renderer &renderer, int w, int h)
+		bool operator==(const Key &) const = default;
+	};
+
+	struct Key_hash {
+		std::size_t operator()(const Key &key) const
+		{
+			std::size_t h = std::hash<std::string>()(key.text);
+			for (std::size_t v : { static_cast<std::size_t>(key.kind), static_cast<std::size_t>(key.w),
+					       static_cast<std::size_t>(key.h), static_cast<std::size_t>(key.style) })
+				h ^= v + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+
+	using Entry = std::pair<Key, SDL::Texture>;
+
+	static constexpr std::size_t cache_capacity = 64;
+	std::list<Entry> lru{}; // most recently used first
+	std::unordered_map<Key, std::list<Entry>::iterator, Key_hash> cache{};
+
+	template <typename F> SDL::Texture cached(Key key, F &&generate)
 	{
-		return create_box(renderer, w, h, 8, 48, 0);
+		if (auto it = cache.find(key); it != cache.end()) {
+			lru.splice(lru.begin(), lru, it->second);
+			return it->second->second;
+		}
+
+		SDL::Texture texture = generate();
+		lru.emplace_front(key, texture);
+		cache.emplace(std::move(key), lru.begin());
+
+		if (lru.size() > cache_capacity) {
+			cache.erase(lru.back().first);
+			lru.pop_back();
+		}
+		return texture;
 	}
 
-	SDL::Texture create_button_over_box(SDL::Renderer &renderer, int w, int h)
+	static Uint32 pack(const SDL::Color &color)
 	{
-		return create_box(renderer, w, h, 8, 48, 24);
+		return static_cast<Uint32>(color.r) << 24 | static_cast<Uint32>(color.g) << 16 |
+		       static_cast<Uint32>(color.b) << 8 | color.a;
 	}
 
-	SDL::Texture create_button(SDL::Renderer &renderer, std::string text, int w, int h)
+	SDL::Texture make_button(SDL::Renderer &renderer, const std::string &text, int w, int h, int off_y)
 	{
 		SDL::Color white = { 255, 255, 255, 255 };
 
-		SDL::Texture texture = create_button_box(renderer, w, h);
+		SDL::Texture texture = create_box(renderer, w, h, 8, 48, off_y);
 		SDL::Texture text_texture(renderer, font.renderText(text, white));
 
 		center(renderer, texture, text_texture, w, h);
@@ -183,7 +235,7 @@ class UI_Factory {
 		return texture;
 	}
 
-	SDL::Texture create_button(SDL::Renderer &renderer, std::string text)
+	SDL::Texture make_button(SDL::Renderer &renderer, const std::string &text, int off_y)
 	{
 		SDL::Color white = { 255, 255, 255, 255 };
 
@@ -191,61 +243,108 @@ class UI_Factory {
 		int w = text_texture.getWidth() + 10;
 		int h = text_texture.getHeight() + 5;
 
-		SDL::Texture texture = create_button_box(renderer, w, h);
+		SDL::Texture texture = create_box(renderer, w, h, 8, 48, off_y);
 
 		center(renderer, texture, text_texture, w, h);
 
 		return texture;
 	}
 
-	SDL::Texture create_button_over(SDL::Renderer &renderer, std::string text, int w, int h)
+    public:
+	UI_Factory(SDL::Renderer &renderer)
+		: sprites(Asset_cache::texture(renderer, "assets/ui.png"))
+		, glyphs(renderer, font)
 	{
-		SDL::Color white = { 255, 255, 255, 255 };
+	}
 
-		SDL::Texture texture = create_button_over_box(renderer, w, h);
-		SDL::Texture text_texture(renderer, font.renderText(text, white));
+	// The factory shared by every state, so its glyphs and memoized widgets survive restarts.
+	static std::shared_ptr<UI_Factory> shared(SDL::Renderer &renderer)
+	{
+		return Asset_cache::shared<UI_Factory>("ui_factory",
+						       [&] { return std::make_shared<UI_Factory>(renderer); });
+	}
 
-		center(renderer, texture, text_texture, w, h);
+	// Glyphs of the label font, for text that changes every frame.
+	const Glyph_atlas &get_glyphs() const
+	{
+		return glyphs;
+	}
 
-		return texture;
+	// Drops every memoized texture and bakes the glyphs again. Must be called when the renderer
+	// reports that its targets or device were reset, since render-target contents are lost and a
+	// device reset loses every texture.
+	void invalidate(SDL::Renderer &renderer)
+	{
+		cache.clear();
+		lru.clear();
+		glyphs = Glyph_atlas(renderer, font);
 	}
 
-	SDL::Texture create_button_over(SDL::Renderer &renderer, std::string text)
+	SDL::Texture create_big_box(SDL::Renderer &renderer, int w, int h)
 	{
-		SDL::Color white = { 255, 255, 255, 255 };
-		SDL::Texture text_texture(renderer, font.renderText(text, white));
+		return cached({ Kind::big_box, {}, w, h, 0 }, [&] { return create_box(renderer, w, h, 16, 0, 0); });
+	}
 
-		int w = text_texture.getWidth() + 10;
-		int h = text_texture.getHeight() + 5;
-		SDL::Texture texture = create_button_over_box(renderer, w, h);
+	SDL::Texture create_button_box(SDL::Renderer &renderer, int w, int h)
+	{
+		return cached({ Kind::button_box, {}, w, h, 0 }, [&] { return create_box(renderer, w, h, 8, 48, 0); });
+	}
 
-		center(renderer, texture, text_texture, w, h);
-		return texture;
+	SDL::Texture create_button_over_box(SDL::Renderer &renderer, int w, int h)
+	{
+		return cached({ Kind::button_over_box, {}, w, h, 0 },
+			      [&] { return create_box(renderer, w, h, 8, 48, 24); });
+	}
+
+	SDL::Texture create_button(SDL::Renderer &renderer, std::string text, int w, int h)
+	{
+		return cached({ Kind::button, text, w, h, 0 }, [&] { return make_button(renderer, text, w, h, 0); });
+	}
+
+	SDL::Texture create_button(SDL::Renderer &renderer, std::string text)
+	{
+		return cached({ Kind::button, text, -1, -1, 0 }, [&] { return make_button(renderer, text, 0); });
+	}
+
+	SDL::Texture create_button_over(SDL::Renderer &renderer, std::string text, int w, int h)
+	{
+		return cached({ Kind::button_over, text, w, h, 0 },
+			      [&] { return make_button(renderer, text, w, h, 24); });
+	}
+
+	SDL::Texture create_button_over(SDL::Renderer &renderer, std::string text)
+	{
+		return cached({ Kind::button_over, text, -1, -1, 0 }, [&] { return make_button(renderer, text, 24); });
 	}
 
 	SDL::Texture create_label(SDL::Renderer &renderer, std::string text, SDL::Color color)
 	{
-		return { renderer, font.renderText(text, color) };
+		return cached({ Kind::label, text, -1, -1, pack(color) },
+			      [&] { return SDL::Texture(renderer, font.renderText(text, color)); });
 	}
 
 	SDL::Texture create_home_button(SDL::Renderer &renderer)
 	{
-		return create_texture(renderer, 16, 16, 0, 48);
+		return cached({ Kind::home_button, {}, 16, 16, 0 },
+			      [&] { return create_texture(renderer, 16, 16, 0, 48); });
 	}
 
 	SDL::Texture create_home_button_over(SDL::Renderer &renderer)
 	{
-		return create_texture(renderer, 16, 16, 0, 64);
+		return cached({ Kind::home_button_over, {}, 16, 16, 0 },
+			      [&] { return create_texture(renderer, 16, 16, 0, 64); });
 	}
 
 	SDL::Texture create_restart_button(SDL::Renderer &renderer)
 	{
-		return create_texture(renderer, 16, 16, 16, 48);
+		return cached({ Kind::restart_button, {}, 16, 16, 0 },
+			      [&] { return create_texture(renderer, 16, 16, 16, 48); });
 	}
 
 	SDL::Texture create_restart_button_over(SDL::Renderer &renderer)
 	{
-		return create_texture(renderer, 16, 16, 16, 64);
+		return cached({ Kind::restart_button_over, {}, 16, 16, 0 },
+			      [&] { return create_texture(renderer, 16, 16, 16, 64); });
 	};
 };
 
@@ -261,9 +360,9 @@ class Material {
 
     public:
 	float x, y;
-	Material(SDL::Renderer renderer, uint durability, bool is_selected, int x, int y)
-		: rect(renderer, "assets/asteroid.png")
-		, rect_h(renderer, "assets/asteroid_highlight.png")
+	Material(SDL::Renderer &renderer, uint durability, bool is_selected, int x, int y)
+		: rect(Asset_cache::texture(renderer, "assets/asteroid.png"))
+		, rect_h(Asset_cache::texture(renderer, "assets/asteroid_highlight.png"))
 		, dura(durability)
 		, selected(is_selected)
 		, x(x)
@@ -289,7 +388,14 @@ class Material {
 		return a >= x && a <= x + w && b >= y && b <= y + h;
 	};
 
-	void draw(SDL::Renderer renderer)
+	// Screen area covered by the sprite drawn for this material.
+	SDL::Rect get_cell() const
+	{
+		constexpr int dim = 96;
+		return { static_cast<int>(x + w / 2 - dim * 0.5), static_cast<int>(y + h / 2 - dim * 0.5), dim, dim };
+	}
+
+	void draw(SDL::Renderer &renderer)
 	{
 		constexpr int max_durability = 5;
 		constexpr int dim = 96;
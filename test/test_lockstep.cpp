@@ -0,0 +1,148 @@
+#include "test_lockstep.h"
+#include "lockstep.h"
+#include "logic.h"
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+static Tick_input scripted(std::size_t player, int tick)
+{
+	Tick_input input;
+	input.dir = static_cast<Paddle::dir>((tick / 20 + static_cast<int>(player)) % 3);
+	input.launch = tick == (player == 0 ? 10 : 40);
+	return input;
+}
+
+// Runs two peers over loopback until both simulated `ticks`, returns false on a stall.
+static bool run(std::array<Logic, 2> &logics, std::array<std::unique_ptr<Lockstep>, 2> &peers, int ticks)
+{
+	for (int i = 0; i < ticks * 100; i++) {
+		bool done = true;
+		for (std::size_t p = 0; p < 2; p++) {
+			Lockstep &peer = *peers[p];
+			if (peer.get_tick() >= ticks)
+				continue;
+			done = false;
+			if (peer.needs_input())
+				peer.input(scripted(p, peer.get_tick()));
+			peer.step(logics[p]);
+		}
+		if (done)
+			return true;
+	}
+	return false;
+}
+
+static std::array<std::unique_ptr<Lockstep>, 2>
+connect(std::chrono::milliseconds timeout = Lockstep::default_timeout)
+{
+	Udp_socket host;
+	Udp_socket guest;
+	guest.connect("127.0.0.1", host.local_port());
+	return { std::make_unique<Lockstep>(std::move(host), 0, 3, 1.f / 60, timeout),
+		 std::make_unique<Lockstep>(std::move(guest), 1, 3, 1.f / 60, timeout) };
+}
+
+bool test_lockstep_loopback()
+{
+	std::array<Logic, 2> logics = { Logic(300, 300, true), Logic(300, 300, true) };
+	for (auto &logic : logics)
+		logic.add_player();
+	auto peers = connect();
+
+	constexpr int ticks = 600;
+	if (!run(logics, peers, ticks)) {
+		std::cerr << "Error: lockstep peers stalled" << std::endl;
+		return false;
+	}
+	if (logics[0].hash() != logics[1].hash() || peers[0]->get_desync() || peers[1]->get_desync()) {
+		std::cerr << "Error: lockstep peers diverged" << std::endl;
+		return false;
+	}
+	if (logics[0].get_lives() != 1) {
+		std::cerr << "Error: launches were not applied on both peers" << std::endl;
+		return false;
+	}
+	// a few dozen bytes per tick, never the state
+	if (peers[0]->get_sent_bytes() > static_cast<std::uint64_t>(ticks) * 32) {
+		std::cerr << "Error: lockstep sends " << peers[0]->get_sent_bytes() << " bytes for " << ticks
+			  << " ticks" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool test_lockstep_desync()
+{
+	std::array<Logic, 2> logics = { Logic(300, 300, true), Logic(300, 300, true) };
+	for (auto &logic : logics)
+		logic.add_player();
+	logics[1].launch_ball(1);
+	auto peers = connect();
+
+	if (!run(logics, peers, 3 * Lockstep::hash_every)) {
+		std::cerr << "Error: lockstep peers stalled" << std::endl;
+		return false;
+	}
+	if (!peers[0]->get_desync() && !peers[1]->get_desync()) {
+		std::cerr << "Error: diverging peers were not detected" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool test_lockstep_peer_left()
+{
+	std::array<Logic, 2> logics = { Logic(300, 300, true), Logic(300, 300, true) };
+	for (auto &logic : logics)
+		logic.add_player();
+	auto peers = connect();
+
+	if (!run(logics, peers, 60) || peers[0]->peer_lost()) {
+		std::cerr << "Error: lockstep peer lost while playing" << std::endl;
+		return false;
+	}
+
+	peers[1].reset();
+	for (int i = 0; i < 100 && !peers[0]->peer_lost(); i++)
+		peers[0]->step(logics[0]);
+	if (!peers[0]->peer_lost()) {
+		std::cerr << "Error: peer leaving was not noticed" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool test_lockstep_pause()
+{
+	std::array<Logic, 2> logics = { Logic(300, 300, true), Logic(300, 300, true) };
+	for (auto &logic : logics)
+		logic.add_player();
+	constexpr auto timeout = std::chrono::milliseconds(100);
+	auto peers = connect(timeout);
+
+	if (!run(logics, peers, 60)) {
+		std::cerr << "Error: lockstep peers stalled" << std::endl;
+		return false;
+	}
+
+	// the second player sits in the pause menu for three timeouts while the first one waits
+	auto resume = std::chrono::steady_clock::now() + 3 * timeout;
+	while (std::chrono::steady_clock::now() < resume) {
+		peers[0]->step(logics[0]);
+		peers[1]->poll();
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	if (peers[0]->peer_lost() || peers[1]->peer_lost()) {
+		std::cerr << "Error: pausing peer was taken for gone" << std::endl;
+		return false;
+	}
+
+	if (!run(logics, peers, 120) || logics[0].hash() != logics[1].hash()) {
+		std::cerr << "Error: lockstep peers did not resume together" << std::endl;
+		return false;
+	}
+	return true;
+}
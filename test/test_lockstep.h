@@ -0,0 +1,6 @@
+#pragma once
+
+bool test_lockstep_loopback();
+bool test_lockstep_desync();
+bool test_lockstep_peer_left();
+bool test_lockstep_pause();
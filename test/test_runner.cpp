@@ -2,13 +2,25 @@
 
 #include <SDL.h>
 
+#include "test_lockstep.h"
 #include "test_save.h"
+#include "test_spectate.h"
 #include <iostream>
 
 int main(void)
 {
 	std::cout << "Running tests..." << std::endl;
 	test_save();
+	test_save_roundtrip();
+	test_save_removed_bricks();
+	test_save_unwritable();
+	test_lockstep_loopback();
+	test_lockstep_desync();
+	test_lockstep_peer_left();
+	test_lockstep_pause();
+	test_spectate_mirror();
+	test_spectate_budget();
+	test_spectate_oversized();
 	std::cout << "Tests complete." << std::endl;
 	return 0;
 }
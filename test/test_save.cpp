@@ -3,6 +3,7 @@
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 bool test_save()
 {
@@ -32,3 +33,76 @@ bool test_save()
 	save_import.close();
 	return true;
 }
+
+bool test_save_roundtrip()
+{
+	Logic logic(300, 300, true);
+	logic.launch_ball();
+	logic.step(16.f / 1000);
+
+	std::stringstream first;
+	logic.save(first);
+
+	Logic logic2 = Logic::load(first);
+	std::stringstream second;
+	logic2.save(second);
+
+	if (first.str() != second.str()) {
+		std::cerr << "Error: save is not stable across a load" << std::endl;
+		return false;
+	}
+	if (logic2.get_lives() != logic.get_lives() || logic2.get_ball_count() != logic.get_ball_count()) {
+		std::cerr << "Error: reloaded state differs" << std::endl;
+		return false;
+	}
+
+	std::string truncated = first.str();
+	truncated.resize(truncated.size() / 2);
+	try {
+		Logic::parse(truncated);
+		std::cerr << "Error: truncated save was accepted" << std::endl;
+		return false;
+	} catch (Bad_format const &) {
+	}
+
+	return true;
+}
+
+bool test_save_removed_bricks()
+{
+	// as the editor does: place bricks, then remove some of them
+	Logic logic(300, 300, false);
+	logic.add_brick_safe(50, 50, 3);
+	logic.add_brick_safe(150, 50, 2);
+	logic.add_brick_safe(250, 50, 1);
+	logic.remove_brick(1);
+	logic.remove_brick(0);
+
+	std::stringstream save;
+	logic.save(save);
+
+	try {
+		Logic logic2 = Logic::load(save);
+		if (logic2.get_bricks().size() != 1) {
+			std::cerr << "Error: removed bricks are still saved" << std::endl;
+			return false;
+		}
+	} catch (Bad_format const &) {
+		std::cerr << "Error: save with removed bricks does not load" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool test_save_unwritable()
+{
+	Logic logic(300, 300);
+	try {
+		logic.save("test/missing/directory.save");
+	} catch (Save_error const &) {
+		return true;
+	}
+	std::cerr << "Error: saving to a missing directory did not fail" << std::endl;
+	return false;
+}
@@ -1,3 +1,6 @@
 #pragma once
 
 bool test_save();
+bool test_save_roundtrip();
+bool test_save_removed_bricks();
+bool test_save_unwritable();
@@ -0,0 +1,131 @@
+#include "test_spectate.h"
+#include "logic.h"
+#include "spectate.h"
+#include <arpa/inet.h>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+bool test_spectate_mirror()
+{
+	Logic host(300, 300, true);
+	host.launch_ball();
+	Spectator_server server;
+	Spectator_view view("127.0.0.1", server.local_port());
+	Logic mirror(1, 1);
+
+	bool resynced = false;
+	for (int i = 0; i < 600; i++) {
+		host.step(1.f / 60);
+		server.publish(host);
+		auto result = view.update(mirror);
+		if (result == Spectator_view::lost) {
+			std::cerr << "Error: spectator lost the stream" << std::endl;
+			return false;
+		}
+		resynced |= result == Spectator_view::resynced;
+	}
+
+	if (!resynced) {
+		std::cerr << "Error: spectator did not report the snapshot" << std::endl;
+		return false;
+	}
+
+	if (mirror.get_tick() != host.get_tick() || mirror.get_score() != host.get_score() ||
+	    mirror.get_width() != host.get_width()) {
+		std::cerr << "Error: spectator is not at the host's tick" << std::endl;
+		return false;
+	}
+	auto bricks = host.get_bricks();
+	auto mirrored = mirror.get_bricks();
+	for (std::size_t i = 0; i < bricks.size(); i++) {
+		if (bricks[i].get_durability() != mirrored[i].get_durability() ||
+		    std::fabs(bricks[i].get_x() - mirrored[i].get_x()) > 0.25f) {
+			std::cerr << "Error: spectator bricks differ" << std::endl;
+			return false;
+		}
+	}
+	auto balls = host.get_balls();
+	auto mirrored_balls = mirror.get_balls();
+	if (balls.size() != mirrored_balls.size() ||
+	    (balls[0].is_alive() && std::fabs(balls[0].get_y() - mirrored_balls[0].get_y()) > 0.25f)) {
+		std::cerr << "Error: spectator balls differ" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool test_spectate_budget()
+{
+	// a dense level: 300 balls moving every tick, 500 bricks
+	std::stringstream save;
+	save << "3000,3000\n0\n0,0\n0,0\n3,1500,2970\n300\n";
+	for (int i = 0; i < 300; i++)
+		save << 100 + i % 30 * 90 << "," << 1500 + i / 30 * 90 << ",1,-1\n";
+	save << "500\n";
+	for (int i = 0; i < 500; i++)
+		save << 30 + (i % 200) * 14 << "," << 30 + (i / 200) * 20 << ",3,0,-1\n";
+	Logic host = Logic::load(save);
+
+	Spectator_server server;
+	Spectator_view view("127.0.0.1", server.local_port());
+	Logic mirror(1, 1);
+
+	constexpr int seconds = 2;
+	std::uint64_t snapshot = 0;
+	for (int i = 0; i < seconds * 60; i++) {
+		host.step(1.f / 60);
+		server.publish(host);
+		if (view.update(mirror) == Spectator_view::lost) {
+			std::cerr << "Error: spectator lost the stream" << std::endl;
+			return false;
+		}
+		if (i == 0)
+			snapshot = server.get_sent_bytes();
+	}
+
+	std::uint64_t rate = (server.get_sent_bytes() - snapshot) / seconds;
+	if (rate > 50 * 1024) {
+		std::cerr << "Error: spectator stream takes " << rate << " bytes/s" << std::endl;
+		return false;
+	}
+	if (mirror.get_tick() == 0) {
+		std::cerr << "Error: spectator never got a delta" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool test_spectate_oversized()
+{
+	// a host announcing a message longer than any the view accepts
+	int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	::bind(listener, reinterpret_cast<sockaddr *>(&addr), len);
+	::listen(listener, 1);
+	::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len);
+
+	Spectator_view view("127.0.0.1", ntohs(addr.sin_port));
+	int host = ::accept(listener, nullptr, nullptr);
+	Stream_writer header;
+	header.u32(static_cast<std::uint32_t>(Spectator_view::max_message + 1));
+	::send(host, header.bytes.data(), header.bytes.size(), 0);
+	::usleep(50000);
+
+	Logic mirror(1, 1);
+	auto result = view.update(mirror);
+	::close(host);
+	::close(listener);
+	if (result != Spectator_view::lost) {
+		std::cerr << "Error: spectator waits for an oversized message" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+bool test_spectate_mirror();
+bool test_spectate_budget();
+bool test_spectate_oversized();
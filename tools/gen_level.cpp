@@ -0,0 +1,220 @@
+#include "exception.h"
+#include "logic.h"
+#include "textio.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numbers>
+#include <optional>
+#include <random>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+// Generates a level for scaling tests, in the save format read by Logic::load.
+//
+//   gen_level [-n bricks] [-s seed] [-x hex] [-d durability] [-p powerups] [-b balls] [-W width] [-H height]
+//             [-o file]
+//
+// -n bricks (default 1000) are spread over a grid in the upper two thirds of the world, -x of them
+// (0 to 1, default 0.5) hexagonal and -p of them (default 0.05) holding a powerup; durabilities are
+// uniform in [1, -d] (default 3). -b balls (default 0) start in the lower third, flying up. Without
+// -W and -H the world is sized to fit the bricks, at most 999999 a side so that every position is
+// saved exactly. The same options and seed always give the same file, written to -o or stdout.
+
+// Random numbers from the raw mt19937_64 sequence, which the standard fixes, rather than
+// distributions, which differ between standard libraries.
+class Random {
+    private:
+	std::mt19937_64 engine;
+
+    public:
+	Random(std::uint64_t seed)
+		: engine(seed)
+	{
+	}
+
+	// In [0, n).
+	std::uint64_t below(std::uint64_t n)
+	{
+		return engine() % n;
+	}
+
+	// In [0, 1).
+	double real()
+	{
+		return static_cast<double>(engine() >> 11) * 0x1p-53;
+	}
+};
+
+// Parses the whole of text as a number, nullopt when it is not one.
+template <typename T> static std::optional<T> parse(const std::string &text)
+{
+	T value{};
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+	if (error != std::errc() || end != text.data() + text.size())
+		return std::nullopt;
+	return value;
+}
+
+int main(int argc, char **argv)
+{
+	// whole numbers up to this are written exactly by Text_writer, with its 6 significant digits
+	constexpr float max_side = 999999;
+	// beyond this the level would not fit in memory anyway
+	constexpr std::size_t max_count = 100'000'000;
+
+	std::size_t bricks = 1000, balls = 0;
+	std::uint64_t seed = 0;
+	double hex = 0.5, powerups = 0.05;
+	unsigned durability = 3;
+	float w = 0, h = 0;
+	std::string output;
+	for (int i = 1; i < argc; i += 2) {
+		std::string opt = argv[i];
+		if (i + 1 == argc) {
+			std::cerr << "Missing value for " << opt << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::string arg = argv[i + 1];
+		bool valid = true;
+		auto read = [&](auto &value, auto low, auto high) {
+			auto parsed = parse<std::remove_reference_t<decltype(value)> >(arg);
+			valid = parsed && *parsed >= low && *parsed <= high;
+			if (valid)
+				value = *parsed;
+		};
+		if (opt == "-n")
+			read(bricks, 0u, max_count);
+		else if (opt == "-s")
+			read(seed, 0u, std::numeric_limits<std::uint64_t>::max());
+		else if (opt == "-x")
+			read(hex, 0., 1.);
+		else if (opt == "-d")
+			read(durability, 1u, 255u);
+		else if (opt == "-p")
+			read(powerups, 0., 1.);
+		else if (opt == "-b")
+			read(balls, 0u, max_count);
+		else if (opt == "-W")
+			read(w, 0.f, max_side);
+		else if (opt == "-H")
+			read(h, 0.f, max_side);
+		else if (opt == "-o")
+			output = arg;
+		else {
+			std::cerr << "Unknown option " << opt << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (!valid) {
+			std::cerr << "Invalid value " << arg << " for " << opt << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// a cell fits either shape with some room around it
+	constexpr float cell_w = 52, cell_h = 36;
+	auto cols = [&] { return static_cast<std::uint64_t>(w / cell_w); };
+	auto rows = [&] { return static_cast<std::uint64_t>(h * 2 / 3 / cell_h); };
+	auto does_not_fit = [&] {
+		std::cerr << bricks << " bricks do not fit in " << w << "x" << h << ", at most " << cols() * rows()
+			  << std::endl;
+		return EXIT_FAILURE;
+	};
+	bool fixed_w = w > 0, fixed_h = h > 0;
+	// growing the other side never makes room in a fixed side too small for a single cell
+	if ((fixed_w && cols() == 0) || (fixed_h && rows() == 0))
+		return does_not_fit();
+	if (!fixed_w || !fixed_h) {
+		// square, with the bricks in two thirds of it, at most max_side wide
+		float area = static_cast<float>(bricks) * cell_w * cell_h * 1.5f;
+		float side = std::max(300.f, std::floor(std::sqrt(area)));
+		for (; side <= max_side; side += cell_h) {
+			w = fixed_w ? w : side;
+			h = fixed_h ? h : side;
+			if (cols() * rows() >= bricks)
+				break;
+		}
+	}
+
+	if (cols() * rows() < bricks)
+		return does_not_fit();
+
+	Random random(seed);
+
+	// `bricks` distinct cells, sampled with Floyd's algorithm so that only the chosen
+	// ones are stored however large the grid, then put back in grid order
+	std::uint64_t grid = cols() * rows();
+	std::unordered_set<std::uint64_t> chosen;
+	chosen.reserve(bricks);
+	for (std::uint64_t j = grid - bricks; j < grid; j++) {
+		std::uint64_t t = random.below(j + 1);
+		chosen.insert(chosen.contains(t) ? j : t);
+	}
+	std::vector<std::uint64_t> cells(chosen.begin(), chosen.end());
+	std::sort(cells.begin(), cells.end());
+
+	// the layout written by Logic::save
+	Text_writer writer;
+	writer.reserve(128 + 48 * balls + 32 * bricks);
+	writer.record(w, h);
+	writer.record(0);
+	writer.record(0, 0);
+	writer.record(0.f, 0);
+	writer.record(3, w / 2, h - Paddle::h);
+
+	writer.record(balls);
+	for (std::size_t i = 0; i < balls; i++) {
+		float x = std::round(Ball::r + static_cast<float>(random.real()) * (w - 2 * Ball::r));
+		float y = std::round(h * 2 / 3 + static_cast<float>(random.real()) * (h / 3 - 2 * Paddle::h));
+		// upwards, at most 45 degrees from vertical
+		double angle = (0.25 + random.real() * 0.5) * std::numbers::pi;
+		writer.record(x, y, static_cast<float>(std::cos(angle)), static_cast<float>(-std::sin(angle)));
+	}
+
+	// positions are whole numbers below max_side, written exactly
+	writer.record(bricks);
+	for (std::uint64_t cell : cells) {
+		float x = static_cast<float>(cell % cols()) * cell_w + cell_w / 2;
+		float y = static_cast<float>(cell / cols()) * cell_h + cell_h / 2;
+		int shape = random.real() < hex ? Brick::hex : Brick::rect;
+		auto dura = static_cast<unsigned>(1 + random.below(durability));
+		int powerup = random.real() < powerups ? static_cast<int>(random.below(Powerup::strong_ball + 1)) : -1;
+		writer.record(x, y, dura, shape, powerup);
+	}
+
+	// the level must load as generated
+	try {
+		Logic level = Logic::parse(writer.view());
+		if (level.get_bricks().size() != bricks) {
+			std::cerr << "Generated level does not load back" << std::endl;
+			return EXIT_FAILURE;
+		}
+	} catch (Bad_format const &) {
+		std::cerr << "Generated level does not load back" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (output.empty()) {
+		writer.flush(std::cout);
+	} else {
+		std::ofstream file(output, std::ios::out | std::ios::binary);
+		writer.flush(file);
+		if (!file) {
+			std::cerr << "Could not write " << output << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	std::cerr << bricks << " bricks and " << balls << " balls in " << w << "x" << h << " ("
+		  << writer.view().size() / 1024 << " KiB)" << std::endl;
+	return EXIT_SUCCESS;
+}
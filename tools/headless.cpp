@@ -0,0 +1,137 @@
+#include "cache.h"
+#include "exception.h"
+#include "fsm.h"
+#include "game.h"
+#include "pacer.h"
+#include "recorder.h"
+#include "script.h"
+#include "sdl.h"
+#include "states.h"
+
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+// Parses the whole of text as a number for option opt.
+template <typename T> static T parse(const std::string &opt, const std::string &text)
+{
+	T value{};
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+	if (error != std::errc() || end != text.data() + text.size())
+		throw std::invalid_argument("Invalid value " + text + " for " + opt);
+	return value;
+}
+
+// Runs the game without a display: the renderer draws into an offscreen surface, time
+// comes from the virtual clock and input from a script, so a run is reproducible.
+//
+//   headless [-l level.save] [-i input.script] [-n frames] [-s seed] [-o out.png] [-c golden.png] [-r dir]
+//
+// Without -i, a random script of -n frames (default 3600) seeded with -s is played.
+// -o writes the last frame and -c compares it with a golden image, failing on any difference.
+// -r records every frame to a directory.
+int main(int argc, char **argv)
+{
+	SDL::setHint("SDL_VIDEODRIVER", "dummy");
+	SDL::setHint("SDL_AUDIODRIVER", "dummy");
+
+	std::string level, input, output, golden, record;
+	Uint64 frames = 3600;
+	unsigned seed = 0;
+	try {
+		for (int i = 1; i < argc; i += 2) {
+			std::string opt = argv[i];
+			if (i + 1 == argc)
+				throw std::invalid_argument("Missing value for " + opt);
+			std::string arg = argv[i + 1];
+			if (opt == "-l")
+				level = arg;
+			else if (opt == "-i")
+				input = arg;
+			else if (opt == "-n")
+				frames = parse<Uint64>(opt, arg);
+			else if (opt == "-s")
+				seed = parse<unsigned>(opt, arg);
+			else if (opt == "-o")
+				output = arg;
+			else if (opt == "-c")
+				golden = arg;
+			else if (opt == "-r")
+				record = arg;
+			else
+				throw std::invalid_argument("Unknown option " + opt);
+		}
+	} catch (std::exception const &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Input_script script = input.empty() ? Input_script::random(frames, seed) : Input_script::load(input);
+
+	// the window only exists for the states that carry it around, nothing is drawn to it
+	SDL::Window window("Meteor", 800, 600, SDL_WINDOW_HIDDEN);
+	SDL::Surface screen(800, 600);
+	SDL::Renderer renderer(screen);
+	renderer.setLogicalSize(400, 300);
+	renderer.setDrawBlendMode(SDL_BLENDMODE_BLEND);
+
+	struct Cache_guard {
+		~Cache_guard()
+		{
+			Asset_cache::clear();
+		}
+	} cache_guard;
+
+	std::optional<Recorder> recorder;
+	if (!record.empty())
+		recorder.emplace(record);
+
+	Virtual_clock::enabled = true;
+	Virtual_clock::on_frame = [&](Uint64 frame) { script(frame); };
+
+	States states(window, renderer);
+	std::shared_ptr<State> game;
+	if (level.empty())
+		game = std::make_shared<Game>(window, renderer, states);
+	else
+		game = std::make_shared<Game>(window, renderer, states, level);
+	FSM fsm(game);
+
+	auto start = std::chrono::steady_clock::now();
+	try {
+		fsm.run();
+	} catch (Close const &) {
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << Virtual_clock::frame << " frames in " << elapsed.count() << " s ("
+		  << static_cast<double>(Virtual_clock::frame) / elapsed.count() << " frames/s)" << std::endl;
+
+	if (!output.empty())
+		screen.savePNG(output);
+
+	if (!golden.empty()) {
+		SDL::Surface reference(golden);
+		auto a = screen.lock();
+		auto b = reference.lock();
+		std::size_t diff = a.size() == b.size() ? 0 : a.size();
+		for (std::size_t i = 0; a.size() == b.size() && i < a.size(); i++)
+			if (a[i].r != b[i].r || a[i].g != b[i].g || a[i].b != b[i].b || a[i].a != b[i].a)
+				diff++;
+		screen.unlock();
+		reference.unlock();
+		if (diff != 0) {
+			std::cerr << diff << " pixels differ from " << golden << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,29 @@
+#include "archive.h"
+#include "sdl.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Decodes every image of assets/ into the asset archive (assets.pak). Run from the
+// repository root, usually through `make archive`.
+int main(void)
+{
+	// no window is ever opened, this lets the packer run on machines without a display
+	SDL::setHint("SDL_VIDEODRIVER", "dummy");
+
+	std::vector<std::string> images;
+	for (const auto &entry : std::filesystem::directory_iterator("assets")) {
+		if (entry.path().extension() == ".png")
+			images.push_back(entry.path().generic_string());
+	}
+	std::sort(images.begin(), images.end());
+
+	Asset_archive::write(Asset_archive::file, images);
+
+	std::cout << "Packed " << images.size() << " images into " << Asset_archive::file << " ("
+		  << std::filesystem::file_size(Asset_archive::file) / 1024 << " KiB)" << std::endl;
+	return 0;
+}
@@ -0,0 +1,24 @@
+#include "atlas.h"
+#include "sdl.h"
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+// Packs every gameplay sprite sheet into assets/atlas.png and writes the frame table
+// to assets/atlas.txt. Run from the repository root, usually through `make atlas`.
+int main(void)
+{
+	// no window is ever opened, this lets the packer run on machines without a display
+	SDL::setHint("SDL_VIDEODRIVER", "dummy");
+
+	std::unordered_map<std::string, Atlas::Frame> frames;
+	SDL::Surface atlas = Atlas::pack(frames);
+
+	atlas.savePNG(Atlas::image_file);
+	Atlas::save_table(Atlas::table_file, frames);
+
+	std::cout << "Packed " << frames.size() << " frames into " << atlas.getWidth() << "x" << atlas.getHeight()
+		  << std::endl;
+	return 0;
+}